@@ -0,0 +1,199 @@
+#include "../src/Console.hpp"
+#include "../src/StaticConsole.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace cr = CppReadline;
+using ret = cr::Console::ReturnCode;
+
+namespace {
+
+    // Discards everything, so that the benchmarks do not measure the terminal.
+    class NullSink : public cr::OutputSink {
+    public:
+        void write(std::string_view) override {}
+    };
+
+    // Only benchmarks whose name contains this are run.
+    std::string filter;
+
+    // Runs f(iterations) with growing iterations until it takes long enough
+    // to be measured, then prints the result as a JSON line.
+    template <typename F>
+    void bench(const std::string &name, std::size_t size, F f) {
+        if (name.find(filter) == std::string::npos) { return; }
+
+        using Clock = std::chrono::steady_clock;
+        std::size_t iterations = 1;
+        double seconds = 0.0;
+        while (true) {
+            auto start = Clock::now();
+            f(iterations);
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (seconds > 0.2 || iterations >= (std::size_t(1) << 30)) { break; }
+            iterations *= seconds < 0.02 ? 10 : 2;
+        }
+        std::printf("{\"benchmark\":\"%s\",\"size\":%zu,\"iterations\":%zu,\"ns_per_op\":%.1f,\"ops_per_second\":%.1f}\n",
+                    name.c_str(), size, iterations, seconds * 1e9 / iterations, iterations / seconds);
+        std::fflush(stdout);
+    }
+
+    // The "views" command of benchDispatch, known at compile time.
+    struct Views {
+        static constexpr std::string_view name = "views";
+
+        int operator()(const cr::Console::ArgumentViews &input) const { return static_cast<int>(input.size()) - 4; }
+    };
+
+    std::string commandName(std::size_t i) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "command%06zu", i);
+        return buffer;
+    }
+
+    void registerCommands(cr::Console &c, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            c.registerCommand(commandName(i), {[](const cr::Console::ArgumentViews &) { return 0; }, {}});
+        }
+    }
+
+    void benchDispatch() {
+        cr::Console c(">");
+        c.setOutputSink(std::make_shared<NullSink>());
+        c.registerCommand("views", {[](const cr::Console::ArgumentViews &input) {
+            return static_cast<int>(input.size()) - 4;
+        }, {}});
+        c.registerCommand("strings", {[](const cr::Console::Arguments &input) {
+            return static_cast<int>(input.size()) - 4;
+        }, {}});
+        c.registerCommand("arena", cr::Console::CommandPmrFunction{[](const cr::Console::PmrArguments &input) {
+            return static_cast<int>(input.size()) - 4;
+        }, {}});
+
+        bench("dispatch/views", 4, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.executeCommand("views first second third"); }
+        });
+        bench("dispatch/strings", 4, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.executeCommand("strings first second third"); }
+        });
+        bench("dispatch/arena", 4, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.executeCommand("arena first second third"); }
+        });
+        bench("dispatch/not_found", 1, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.executeCommand("missing"); }
+        });
+
+        cr::StaticConsole<Views> fixed;
+        bench("dispatch/static", 4, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { fixed.execute("views first second third"); }
+        });
+    }
+
+    void benchCompletion(std::size_t count) {
+        cr::Console c(">");
+        registerCommands(c, count);
+        // The completion argument candidates live on a single command.
+        std::vector<std::string> candidates;
+        for (std::size_t i = 0; i < count; ++i) { candidates.push_back(commandName(i)); }
+        c.registerCommand("pick", {[](const cr::Console::ArgumentViews &) { return 0; }, candidates});
+        // The same candidates, coming from a completion provider.
+        cr::CommandOptions provided;
+        provided.completion = [candidates] { return candidates; };
+        c.registerCommand("host", {[](const cr::Console::ArgumentViews &) { return 0; }, {}}, provided);
+
+        // At most ten commands share this prefix.
+        auto prefix = commandName(count / 2).substr(0, 12);
+        bench("complete/command_prefix", count, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.getCompletions(prefix); }
+        });
+        c.setCompletionMode(cr::Console::CompletionMode::Substring);
+        auto infix = prefix.substr(3);
+        bench("complete/command_substring", count, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.getCompletions(infix); }
+        });
+        auto line = "pick " + prefix;
+        bench("complete/argument", count, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.getCompletions(line); }
+        });
+        auto provider = "host " + prefix;
+        bench("complete/provider_substring", count, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.getCompletions(provider); }
+        });
+        c.setCompletionMode(cr::Console::CompletionMode::Prefix);
+        bench("complete/provider_prefix", count, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.getCompletions(provider); }
+        });
+        c.setCompletionMode(cr::Console::CompletionMode::Fuzzy);
+        // Scattered characters of the names, as typed when fuzzy matching.
+        auto scattered = "cmd" + prefix.substr(9);
+        bench("complete/command_fuzzy", count, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.getCompletions(scattered); }
+        });
+        auto fuzzy = "host " + scattered;
+        bench("complete/provider_fuzzy", count, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.getCompletions(fuzzy); }
+        });
+    }
+
+    void benchScripts(std::size_t lines) {
+        char filename[] = "/tmp/cpp-readline-bench-XXXXXX";
+        int fd = mkstemp(filename);
+        if (fd < 0) { return; }
+        close(fd);
+        {
+            std::ofstream script(filename);
+            for (std::size_t i = 0; i < lines; ++i) {
+                if (i % 100 == 0) { script << "# A comment\n"; }
+                script << "work " << i << " some arguments\n";
+            }
+        }
+
+        cr::Console c(">");
+        c.setOutputSink(std::make_shared<NullSink>());
+        c.setQuiet(true);
+        c.registerCommand("work", {[](const cr::Console::ArgumentViews &) { return 0; }, {}});
+
+        auto run = [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.executeFile(filename); }
+        };
+        bench("script/mapped", lines, run);
+        c.setMappedScripts(false);
+        bench("script/streamed", lines, run);
+        c.setScriptCaching(true);
+        bench("script/cached", lines, run);
+        bench("script/cached_parallel", lines, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { c.executeFile(filename, cr::ScriptOptions{4}); }
+        });
+
+        unlink(filename);
+    }
+
+    void benchSwitching(std::size_t consoles) {
+        std::vector<std::unique_ptr<cr::Console>> all;
+        for (std::size_t i = 0; i < consoles; ++i) { all.emplace_back(new cr::Console(">")); }
+
+        bench("switch/reserve_console", consoles, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) { all[i % consoles]->reserveConsole(); }
+        });
+    }
+
+}  /* namespace  */
+
+int main(int argc, char **argv) {
+    // The optional argument selects the benchmarks to run, e.g. "complete/".
+    if (argc > 1) { filter = argv[1]; }
+
+    benchDispatch();
+    for (std::size_t count : {10, 1000, 100000}) { benchCompletion(count); }
+    benchScripts(100000);
+    benchSwitching(12);
+
+    return ret::Ok;
+}
@@ -13,21 +13,9 @@ unsigned info(const std::vector<std::string> &) {
     return ret::Ok;
 }
 
-// In this command we implement a basic calculator
-unsigned calc(const std::vector<std::string> & input) {
-    if ( input.size() != 4 ) {
-        // The first element of the input array is always the name of the
-        // command as registered in the console.
-        std::cout << "Usage: " << input[0] << " num1 operator num2\n";
-        // We can return an arbitrary error code, which we can catch later
-        // as Console will return it.
-        return 1;
-    }
-    double num1 = std::stod(input[1]),
-           num2 = std::stod(input[3]);
-
-    char op = input[2][0];
-
+// In this command we implement a basic calculator. Its arguments are parsed
+// by the console, which prints the usage if they do not fit the signature.
+unsigned calc(double num1, char op, double num2) {
     double result;
     switch ( op ) {
         case '*':
@@ -44,7 +32,8 @@ unsigned calc(const std::vector<std::string> & input) {
             break;
         default:
             std::cout << "The inserted operator is not supported\n";
-            // Again, we can return an arbitrary error code to catch it later.
+            // We can return an arbitrary error code, which we can catch later
+            // as Console will return it.
             return 2;
     }
     std::cout << "Result: " << result << '\n';
@@ -60,7 +49,9 @@ int main() {
     // Here we register a new command. The string "info" names the command that
     // the user will have to type in in order to trigger this command (it can
     // be different from the function name).
-    c.registerCommand("info", info);
+    // The second element lists the arguments the command can complete.
+    c.registerCommand("info", {info, {}});
+    // Commands can also take typed arguments, deduced from the function.
     c.registerCommand("calc", calc);
 
     // Here we call one of the defaults command of the console, "help". It lists
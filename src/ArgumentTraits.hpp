@@ -0,0 +1,214 @@
+#ifndef CONSOLE_ARGUMENT_TRAITS_HEADER_FILE
+#define CONSOLE_ARGUMENT_TRAITS_HEADER_FILE
+
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This struct tells how a typed command argument is parsed and described.
+     *
+     * It is specialized for integers, floating point numbers, bool, char,
+     * std::string, std::string_view and std::optional of those. An optional
+     * argument may be left out, but only after all required ones.
+     */
+    template <typename T, typename = void>
+    struct ArgumentTraits {
+        static constexpr bool supported = false;
+    };
+
+    template <typename T>
+    struct ArgumentTraits<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                                              !std::is_same_v<T, char>>> {
+        static constexpr bool supported = true;
+        static constexpr bool optional = false;
+        static constexpr std::string_view name = std::is_signed_v<T> ? "integer" : "count";
+
+        static bool parse(std::string_view text, T &value) {
+            auto end = text.data() + text.size();
+            auto result = std::from_chars(text.data(), end, value);
+            return result.ec == std::errc() && result.ptr == end;
+        }
+    };
+
+    template <typename T>
+    struct ArgumentTraits<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+        static constexpr bool supported = true;
+        static constexpr bool optional = false;
+        static constexpr std::string_view name = "number";
+
+        static bool parse(std::string_view text, T &value) {
+            auto end = text.data() + text.size();
+            auto result = std::from_chars(text.data(), end, value);
+            return result.ec == std::errc() && result.ptr == end;
+        }
+    };
+
+    template <>
+    struct ArgumentTraits<bool> {
+        static constexpr bool supported = true;
+        static constexpr bool optional = false;
+        static constexpr std::string_view name = "true|false";
+
+        static bool parse(std::string_view text, bool &value) {
+            if (text == "true" || text == "1" || text == "on" || text == "yes") {
+                value = true;
+            } else if (text == "false" || text == "0" || text == "off" || text == "no") {
+                value = false;
+            } else {
+                return false;
+            }
+            return true;
+        }
+    };
+
+    template <>
+    struct ArgumentTraits<char> {
+        static constexpr bool supported = true;
+        static constexpr bool optional = false;
+        static constexpr std::string_view name = "character";
+
+        static bool parse(std::string_view text, char &value) {
+            if (text.size() != 1) { return false; }
+            value = text[0];
+            return true;
+        }
+    };
+
+    // Views point into the executed line, so they are only valid during the call.
+    template <typename T>
+    struct ArgumentTraits<T, std::enable_if_t<std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>>> {
+        static constexpr bool supported = true;
+        static constexpr bool optional = false;
+        static constexpr std::string_view name = "text";
+
+        static bool parse(std::string_view text, T &value) {
+            value = T(text);
+            return true;
+        }
+    };
+
+    template <typename T>
+    struct ArgumentTraits<std::optional<T>, std::enable_if_t<ArgumentTraits<T>::supported>> {
+        static constexpr bool supported = true;
+        static constexpr bool optional = true;
+        static constexpr std::string_view name = ArgumentTraits<T>::name;
+
+        static bool parse(std::string_view text, std::optional<T> &value) {
+            return ArgumentTraits<T>::parse(text, value.emplace());
+        }
+    };
+
+    /**
+     * @brief This struct tells the arguments of a handler of a typed command.
+     *
+     * Only handlers with a single, non template call operator qualify, and
+     * only if all of their arguments are supported by ArgumentTraits.
+     */
+    template <typename F, typename = void>
+    struct HandlerTraits {
+        static constexpr bool supported = false;
+    };
+
+    template <typename R, typename... A>
+    struct HandlerTraits<R (*)(A...)> {
+        using Result = R;
+        using Arguments = std::tuple<std::decay_t<A>...>;
+
+        static constexpr bool supported = (ArgumentTraits<std::decay_t<A>>::supported && ... && true) &&
+                                          (std::is_void_v<R> || std::is_convertible_v<R, int>);
+    };
+
+    template <typename R, typename... A>
+    struct HandlerTraits<R (A...)> : HandlerTraits<R (*)(A...)> {};
+
+    template <typename C, typename R, typename... A>
+    struct HandlerTraits<R (C::*)(A...)> : HandlerTraits<R (*)(A...)> {};
+
+    template <typename C, typename R, typename... A>
+    struct HandlerTraits<R (C::*)(A...) const> : HandlerTraits<R (*)(A...)> {};
+
+    template <typename F>
+    struct HandlerTraits<F, std::void_t<decltype(&F::operator())>> : HandlerTraits<decltype(&F::operator())> {};
+
+    /**
+     * @brief This struct parses the arguments of a typed command into a tuple.
+     */
+    template <typename Tuple>
+    struct ArgumentParser;
+
+    template <typename... A>
+    struct ArgumentParser<std::tuple<A...>> {
+        static constexpr std::size_t count = sizeof...(A);
+
+        // The number of arguments before the first optional one.
+        static constexpr std::size_t required() {
+            constexpr bool optional[] = {ArgumentTraits<A>::optional..., true};
+            std::size_t i = 0;
+            while (!optional[i]) { ++i; }
+            return i;
+        }
+
+        static constexpr bool optionalsLast() {
+            constexpr bool optional[] = {ArgumentTraits<A>::optional..., true};
+            for (std::size_t i = required(); i < count; ++i) {
+                if (!optional[i]) { return false; }
+            }
+            return true;
+        }
+
+        static_assert(optionalsLast(), "Optional arguments must come after all required ones");
+
+        /**
+         * @brief This function parses the views, skipping the command name in front.
+         *
+         * @return Whether the number of views fits and all of them parsed.
+         */
+        static bool parse(const std::vector<std::string_view> &views, std::tuple<A...> &values) {
+            auto given = views.size() - 1;
+            if (given < required() || given > count) { return false; }
+            return parse(views, values, std::index_sequence_for<A...>());
+        }
+
+        /**
+         * @brief This function returns how to call the command, e.g. "name <integer> [text]".
+         */
+        static std::string usage(const std::string &name) {
+            std::string usage = name;
+            constexpr std::string_view names[] = {ArgumentTraits<A>::name..., ""};
+            constexpr bool optional[] = {ArgumentTraits<A>::optional..., true};
+            for (std::size_t i = 0; i < count; ++i) {
+                usage.append(optional[i] ? " [" : " <").append(names[i]).append(optional[i] ? "]" : ">");
+            }
+            return usage;
+        }
+
+        /**
+         * @brief This function returns the candidates for completing the arguments.
+         */
+        static std::vector<std::string> candidates() {
+            constexpr bool booleans = (std::is_same_v<A, bool> || ... || false) ||
+                                      (std::is_same_v<A, std::optional<bool>> || ... || false);
+            if (booleans) { return {"false", "true"}; }
+            return {};
+        }
+
+    private:
+        template <std::size_t... I>
+        static bool parse(const std::vector<std::string_view> &views, std::tuple<A...> &values,
+                          std::index_sequence<I...>) {
+            // Left out optionals stay empty.
+            return ((I + 1 >= views.size() || ArgumentTraits<A>::parse(views[I + 1], std::get<I>(values))) && ...
+                    && true);
+        }
+    };
+}
+
+#endif
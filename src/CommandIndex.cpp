@@ -0,0 +1,311 @@
+#include "CommandIndex.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace CppReadline {
+    namespace {
+
+        std::size_t commonPrefix(std::string_view a, std::string_view b) {
+            std::size_t i = 0, size = std::min(a.size(), b.size());
+            while (i < size && a[i] == b[i]) { ++i; }
+            return i;
+        }
+
+        std::uint32_t trigram(const char *c) {
+            return static_cast<std::uint32_t>(static_cast<unsigned char>(c[0])) << 16 |
+                   static_cast<std::uint32_t>(static_cast<unsigned char>(c[1])) << 8 |
+                   static_cast<std::uint32_t>(static_cast<unsigned char>(c[2]));
+        }
+
+    }  /* namespace  */
+
+    struct CommandIndex::Node {
+        using Children = std::vector<std::unique_ptr<Node>>;
+
+        // The part of the name on the edge leading to this node.
+        std::string label;
+        // Set if a name ends at this node. It is kept on the heap so that it
+        // does not move when nodes are split or merged.
+        std::unique_ptr<std::string> key;
+        // Sorted by the first character of their labels.
+        Children children;
+        // The number of names ending at or below this node.
+        std::size_t count;
+
+        explicit Node(std::string_view l) : label(l), key(), children(), count(0) {}
+
+        Children::iterator find(char c) {
+            return std::lower_bound(children.begin(), children.end(), c,
+                                    [](const std::unique_ptr<Node> &n, char c) {
+                                        return static_cast<unsigned char>(n->label[0]) <
+                                               static_cast<unsigned char>(c);
+                                    });
+        }
+
+        const Node *child(char c) const {
+            auto it = const_cast<Node *>(this)->find(c);
+            if (it == children.end() || (*it)->label[0] != c) { return nullptr; }
+            return it->get();
+        }
+    };
+
+    CommandIndex::CommandIndex() : root_(new Node("")), size_(0), substringIndex_(false), trigrams_() {}
+
+    CommandIndex::~CommandIndex() = default;
+
+    bool CommandIndex::insert(std::string_view name) {
+        auto key = add(name);
+        if (!key) { return false; }
+        if (substringIndex_) { indexTrigrams(*key); }
+        return true;
+    }
+
+    std::size_t CommandIndex::insert(const std::vector<std::string_view> &names) {
+        std::vector<const std::string *> keys;
+        keys.reserve(names.size());
+        for (auto name : names) {
+            if (auto key = add(name)) { keys.push_back(key); }
+        }
+        if (!substringIndex_ || keys.empty()) { return keys.size(); }
+
+        // Append to the postings first, and restore their order once.
+        std::vector<Posting *> touched;
+        for (auto key : keys) {
+            for (std::size_t i = 0; i + 3 <= key->size(); ++i) {
+                auto &posting = trigrams_[trigram(key->data() + i)];
+                if (posting.empty() || posting.back() != key) { posting.push_back(key); }
+                touched.push_back(&posting);
+            }
+        }
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        for (auto posting : touched) {
+            std::sort(posting->begin(), posting->end(), std::less<const std::string *>());
+            posting->erase(std::unique(posting->begin(), posting->end()), posting->end());
+        }
+        return keys.size();
+    }
+
+    const std::string *CommandIndex::add(std::string_view name) {
+        Node *node = root_.get();
+        std::string_view rest = name;
+        while (!rest.empty()) {
+            auto it = node->find(rest[0]);
+            if (it == node->children.end() || (*it)->label[0] != rest[0]) {
+                it = node->children.emplace(it, new Node(rest));
+                node = it->get();
+                break;
+            }
+            auto common = commonPrefix((*it)->label, rest);
+            if (common < (*it)->label.size()) {
+                // The name diverges in the middle of the edge, so split it.
+                std::unique_ptr<Node> split(new Node(rest.substr(0, common)));
+                split->count = (*it)->count;
+                (*it)->label.erase(0, common);
+                split->children.push_back(std::move(*it));
+                *it = std::move(split);
+            }
+            node = it->get();
+            rest.remove_prefix(common);
+        }
+        if (node->key) { return nullptr; }
+
+        node->key.reset(new std::string(name));
+        ++size_;
+        // All nodes on the path get one more name below them.
+        rest = name;
+        for (Node *n = root_.get(); ; ) {
+            ++n->count;
+            if (n == node) { break; }
+            n = n->find(rest[0])->get();
+            rest.remove_prefix(n->label.size());
+        }
+        return node->key.get();
+    }
+
+    bool CommandIndex::erase(std::string_view name) {
+        auto key = findKey(name);
+        if (!key) { return false; }
+        if (substringIndex_) { unindexTrigrams(*key); }
+        return remove(name);
+    }
+
+    std::size_t CommandIndex::erase(const std::vector<std::string_view> &names) {
+        std::vector<const std::string *> keys;
+        for (auto name : names) {
+            if (auto key = findKey(name)) { keys.push_back(key); }
+        }
+        if (substringIndex_) { unindexTrigrams(keys); }
+        std::size_t erased = 0;
+        for (auto name : names) { erased += remove(name); }
+        return erased;
+    }
+
+    const std::string *CommandIndex::findKey(std::string_view name) const {
+        const Node *node = root_.get();
+        std::string_view rest = name;
+        while (!rest.empty()) {
+            node = node->child(rest[0]);
+            if (!node || rest.compare(0, node->label.size(), node->label) != 0) { return nullptr; }
+            rest.remove_prefix(node->label.size());
+        }
+        return node->key.get();
+    }
+
+    bool CommandIndex::remove(std::string_view name) {
+        // Remember the path, since nodes left behind may need to be merged.
+        std::vector<std::pair<Node *, Node::Children::iterator>> path;
+        Node *node = root_.get();
+        std::string_view rest = name;
+        while (!rest.empty()) {
+            auto it = node->find(rest[0]);
+            if (it == node->children.end() || (*it)->label[0] != rest[0]) { return false; }
+            auto &label = (*it)->label;
+            if (rest.compare(0, label.size(), label) != 0) { return false; }
+            path.emplace_back(node, it);
+            node = it->get();
+            rest.remove_prefix(label.size());
+        }
+        if (!node->key) { return false; }
+
+        node->key.reset();
+        --size_;
+        --node->count;
+        for (auto &step : path) { --step.first->count; }
+
+        if (path.empty()) { return true; }
+        auto parent = path.back();
+        if (node->children.empty()) {
+            parent.first->children.erase(parent.second);
+            // The parent may now be an inner node with a single child.
+            if (path.size() < 2) { return true; }
+            node = parent.first;
+        }
+        if (!node->key && node->children.size() == 1) {
+            std::unique_ptr<Node> child = std::move(node->children.front());
+            node->label += child->label;
+            node->key = std::move(child->key);
+            node->children = std::move(child->children);
+        }
+        return true;
+    }
+
+    std::size_t CommandIndex::size() const {
+        return size_;
+    }
+
+    void CommandIndex::setSubstringIndex(bool enabled) {
+        if (enabled == substringIndex_) { return; }
+        substringIndex_ = enabled;
+        trigrams_.clear();
+        if (!enabled) { return; }
+
+        std::vector<const Node *> pending{root_.get()};
+        while (!pending.empty()) {
+            const Node *node = pending.back();
+            pending.pop_back();
+            if (node->key) { indexTrigrams(*node->key); }
+            for (auto &child : node->children) { pending.push_back(child.get()); }
+        }
+    }
+
+    void CommandIndex::findPrefix(std::string_view prefix, Matches &matches) const {
+        if (auto *node = findNode(prefix)) { collect(*node, matches); }
+    }
+
+    std::string_view CommandIndex::findUnique(std::string_view prefix) const {
+        const Node *node = findNode(prefix);
+        if (!node || node->count != 1) { return std::string_view(); }
+        // Only one path leads on to the name.
+        while (!node->key) {
+            node = std::find_if(node->children.begin(), node->children.end(),
+                                [](const std::unique_ptr<Node> &child) { return child->count > 0; })->get();
+        }
+        return *node->key;
+    }
+
+    void CommandIndex::findSubstring(std::string_view text, Matches &matches) const {
+        if (!substringIndex_ || text.size() < 3) {
+            Matches all;
+            collect(*root_, all);
+            for (auto &name : all) {
+                if (name.find(text) != std::string_view::npos) { matches.push_back(name); }
+            }
+            return;
+        }
+
+        // Any name containing text contains all of its trigrams, so it is
+        // enough to check the names in the shortest posting list.
+        const Posting *shortest = nullptr;
+        for (std::size_t i = 0; i + 3 <= text.size(); ++i) {
+            auto it = trigrams_.find(trigram(text.data() + i));
+            if (it == trigrams_.end()) { return; }
+            if (!shortest || it->second.size() < shortest->size()) { shortest = &it->second; }
+        }
+
+        auto first = matches.size();
+        for (auto name : *shortest) {
+            if (name->find(text) != std::string::npos) { matches.emplace_back(*name); }
+        }
+        std::sort(matches.begin() + static_cast<std::ptrdiff_t>(first), matches.end());
+    }
+
+    const CommandIndex::Node *CommandIndex::findNode(std::string_view prefix) const {
+        const Node *node = root_.get();
+        std::string_view rest = prefix;
+        while (!rest.empty()) {
+            node = node->child(rest[0]);
+            if (!node) { return nullptr; }
+            auto common = commonPrefix(node->label, rest);
+            if (common < rest.size() && common < node->label.size()) { return nullptr; }
+            rest.remove_prefix(common);
+        }
+        return node;
+    }
+
+    void CommandIndex::collect(const Node &node, Matches &matches) {
+        // A key sorts before all the longer names below it.
+        if (node.key) { matches.emplace_back(*node.key); }
+        for (auto &child : node.children) { collect(*child, matches); }
+    }
+
+    void CommandIndex::indexTrigrams(const std::string &name) {
+        for (std::size_t i = 0; i + 3 <= name.size(); ++i) {
+            auto &posting = trigrams_[trigram(name.data() + i)];
+            auto it = std::lower_bound(posting.begin(), posting.end(), &name, std::less<const std::string *>());
+            if (it == posting.end() || *it != &name) { posting.insert(it, &name); }
+        }
+    }
+
+    void CommandIndex::unindexTrigrams(const std::string &name) {
+        for (std::size_t i = 0; i + 3 <= name.size(); ++i) {
+            auto gram = trigrams_.find(trigram(name.data() + i));
+            if (gram == trigrams_.end()) { continue; }
+            auto &posting = gram->second;
+            auto it = std::lower_bound(posting.begin(), posting.end(), &name, std::less<const std::string *>());
+            if (it != posting.end() && *it == &name) { posting.erase(it); }
+            if (posting.empty()) { trigrams_.erase(gram); }
+        }
+    }
+
+    void CommandIndex::unindexTrigrams(const std::vector<const std::string *> &names) {
+        std::vector<const std::string *> sorted(names);
+        std::sort(sorted.begin(), sorted.end(), std::less<const std::string *>());
+        std::vector<std::uint32_t> grams;
+        for (auto name : names) {
+            for (std::size_t i = 0; i + 3 <= name->size(); ++i) { grams.push_back(trigram(name->data() + i)); }
+        }
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        for (auto gram : grams) {
+            auto it = trigrams_.find(gram);
+            if (it == trigrams_.end()) { continue; }
+            auto &posting = it->second;
+            posting.erase(std::remove_if(posting.begin(), posting.end(), [&sorted](const std::string *name) {
+                return std::binary_search(sorted.begin(), sorted.end(), name, std::less<const std::string *>());
+            }), posting.end());
+            if (posting.empty()) { trigrams_.erase(it); }
+        }
+    }
+}
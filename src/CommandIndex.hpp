@@ -0,0 +1,131 @@
+#ifndef CONSOLE_COMMAND_INDEX_HEADER_FILE
+#define CONSOLE_COMMAND_INDEX_HEADER_FILE
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class keeps a set of names indexed for completion.
+     *
+     * Names are stored in a radix tree, so finding all the names starting with
+     * a prefix costs O(prefix + matches) and yields them in sorted order.
+     * Each node counts the names below it, so whether a prefix is unique
+     * takes O(prefix) as well.
+     *
+     * Optionally a trigram index is maintained as well, which answers substring
+     * queries by only looking at names sharing a trigram with the query.
+     */
+    class CommandIndex {
+    public:
+        using Matches = std::vector<std::string_view>;
+
+        CommandIndex();
+
+        ~CommandIndex();
+
+        /**
+         * @brief This function adds a name to the index.
+         *
+         * @return Whether the name was not already present.
+         */
+        bool insert(std::string_view name);
+
+        /**
+         * @brief This function adds several names at once.
+         *
+         * The trigram index is updated once for all of them, instead of once
+         * per name.
+         *
+         * @return The number of names which were not already present.
+         */
+        std::size_t insert(const std::vector<std::string_view> &names);
+
+        /**
+         * @brief This function removes a name from the index.
+         *
+         * @return Whether the name was present.
+         */
+        bool erase(std::string_view name);
+
+        /**
+         * @brief This function removes several names at once.
+         *
+         * @return The number of names which were present.
+         */
+        std::size_t erase(const std::vector<std::string_view> &names);
+
+        /**
+         * @brief This function returns the number of indexed names.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief This function enables or disables the trigram index.
+         *
+         * Enabling it indexes all the names already present.
+         */
+        void setSubstringIndex(bool enabled);
+
+        /**
+         * @brief This function appends all names starting with prefix, in sorted order.
+         *
+         * The views stay valid until the name is erased from the index.
+         */
+        void findPrefix(std::string_view prefix, Matches &matches) const;
+
+        /**
+         * @brief This function returns the only name starting with prefix.
+         *
+         * @return The name, or an empty view if no or several names start with prefix.
+         */
+        std::string_view findUnique(std::string_view prefix) const;
+
+        /**
+         * @brief This function appends all names containing text, in sorted order.
+         *
+         * Without the trigram index this has to look at every name.
+         */
+        void findSubstring(std::string_view text, Matches &matches) const;
+
+    private:
+        CommandIndex(const CommandIndex &) = delete;
+
+        CommandIndex &operator=(const CommandIndex &) = delete;
+
+        struct Node;
+        using Posting = std::vector<const std::string *>;
+
+        static void collect(const Node &node, Matches &matches);
+
+        // Adds a name to the tree only, returning its key or nullptr if present.
+        const std::string *add(std::string_view name);
+
+        // Removes a name from the tree only.
+        bool remove(std::string_view name);
+
+        const std::string *findKey(std::string_view name) const;
+
+        // Returns the node below which all names start with prefix, if any.
+        const Node *findNode(std::string_view prefix) const;
+
+        void indexTrigrams(const std::string &name);
+
+        void unindexTrigrams(const std::string &name);
+
+        // Like calling unindexTrigrams for each name, touching every posting once.
+        void unindexTrigrams(const std::vector<const std::string *> &names);
+
+        std::unique_ptr<Node> root_;
+        std::size_t size_;
+        bool substringIndex_;
+        // Maps three packed characters to the names containing them, sorted by address.
+        std::unordered_map<std::uint32_t, Posting> trigrams_;
+    };
+}
+
+#endif
@@ -0,0 +1,196 @@
+#include "CommandRegistry.hpp"
+
+#include <mutex>
+
+namespace CppReadline {
+    CommandRegistry::CommandRegistry()
+            : shards_(), indexMutex_(), index_(), generation_(0), aliasMutex_(), aliases_() {}
+
+    void CommandRegistry::insert(Pointer command) {
+        std::string_view key = command->name;
+        auto &shard = shardOf(key);
+        // The replaced command is released after the locks.
+        Pointer replaced;
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.commands.find(key);
+        if (it != shard.commands.end()) {
+            // The old key views the name of the command being replaced.
+            replaced = std::move(it->second);
+            shard.commands.erase(it);
+        }
+        shard.commands.emplace(key, std::move(command));
+        ++generation_;
+        if (!replaced) {
+            std::unique_lock<std::shared_mutex> indexLock(indexMutex_);
+            index_.insert(key);
+        }
+    }
+
+    void CommandRegistry::insert(std::vector<Pointer> commands) {
+        std::array<std::vector<Pointer>, std::tuple_size<decltype(shards_)>::value> byShard;
+        for (auto &command : commands) { byShard[shardIndex(command->name)].push_back(std::move(command)); }
+        // Allocated up front, so that only the map and index updates allocate under the locks.
+        std::vector<Pointer> replaced;
+        replaced.reserve(commands.size());
+        std::vector<std::string_view> added;
+        added.reserve(commands.size());
+
+        std::array<std::unique_lock<std::shared_mutex>, std::tuple_size<decltype(shards_)>::value> locks;
+        for (std::size_t i = 0; i < shards_.size(); ++i) {
+            if (byShard[i].empty()) { continue; }
+            locks[i] = std::unique_lock<std::shared_mutex>(shards_[i].mutex);
+            auto &map = shards_[i].commands;
+            for (auto &command : byShard[i]) {
+                std::string_view key = command->name;
+                auto it = map.find(key);
+                if (it != map.end()) {
+                    replaced.push_back(std::move(it->second));
+                    map.erase(it);
+                } else {
+                    added.push_back(key);
+                }
+                map.emplace(key, std::move(command));
+            }
+        }
+        ++generation_;
+        std::unique_lock<std::shared_mutex> indexLock(indexMutex_);
+        index_.insert(added);
+    }
+
+    bool CommandRegistry::erase(std::string_view name) {
+        auto &shard = shardOf(name);
+        Pointer erased;
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.commands.find(name);
+        if (it == shard.commands.end()) { return false; }
+        erased = std::move(it->second);
+        shard.commands.erase(it);
+        ++generation_;
+        std::unique_lock<std::shared_mutex> indexLock(indexMutex_);
+        // The name is still owned by the erased command.
+        index_.erase(erased->name);
+        return true;
+    }
+
+    std::size_t CommandRegistry::erasePrefix(std::string_view prefix) {
+        std::vector<Pointer> erased;
+        std::vector<std::string_view> names;
+        {
+            std::array<std::unique_lock<std::shared_mutex>, std::tuple_size<decltype(shards_)>::value> locks;
+            for (std::size_t i = 0; i < shards_.size(); ++i) {
+                locks[i] = std::unique_lock<std::shared_mutex>(shards_[i].mutex);
+            }
+            std::unique_lock<std::shared_mutex> indexLock(indexMutex_);
+            CommandIndex::Matches matches;
+            index_.findPrefix(prefix, matches);
+            if (matches.empty()) { return 0; }
+            erased.reserve(matches.size());
+            for (auto match : matches) {
+                auto &map = shardOf(match).commands;
+                auto it = map.find(match);
+                if (it == map.end()) { continue; }
+                erased.push_back(std::move(it->second));
+                map.erase(it);
+                names.push_back(erased.back()->name);
+            }
+            ++generation_;
+            index_.erase(names);
+        }
+        return erased.size();
+    }
+
+    CommandRegistry::Pointer CommandRegistry::find(std::string_view name) const {
+        auto &shard = shardOf(name);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.commands.find(name);
+        return it != shard.commands.end() ? it->second : nullptr;
+    }
+
+    std::uint64_t CommandRegistry::generation() const {
+        return generation_;
+    }
+
+    CommandRegistry::Names CommandRegistry::names() const {
+        Names names;
+        findPrefix("", names);
+        return names;
+    }
+
+    CommandRegistry::Pointer CommandRegistry::findUnique(std::string_view prefix) const {
+        std::string name;
+        {
+            std::shared_lock<std::shared_mutex> lock(indexMutex_);
+            auto unique = index_.findUnique(prefix);
+            if (unique.empty()) { return nullptr; }
+            // The view is only valid under the index lock.
+            name.assign(unique.data(), unique.size());
+        }
+        return find(name);
+    }
+
+    void CommandRegistry::insertAlias(AliasPointer alias) {
+        std::string_view key = alias->name;
+        AliasPointer replaced;
+        std::unique_lock<std::shared_mutex> lock(aliasMutex_);
+        auto it = aliases_.find(key);
+        if (it != aliases_.end()) {
+            replaced = std::move(it->second);
+            aliases_.erase(it);
+        }
+        aliases_.emplace(key, std::move(alias));
+    }
+
+    bool CommandRegistry::eraseAlias(std::string_view name) {
+        AliasPointer erased;
+        std::unique_lock<std::shared_mutex> lock(aliasMutex_);
+        auto it = aliases_.find(name);
+        if (it == aliases_.end()) { return false; }
+        erased = std::move(it->second);
+        aliases_.erase(it);
+        return true;
+    }
+
+    CommandRegistry::AliasPointer CommandRegistry::findAlias(std::string_view name) const {
+        std::shared_lock<std::shared_mutex> lock(aliasMutex_);
+        auto it = aliases_.find(name);
+        return it != aliases_.end() ? it->second : nullptr;
+    }
+
+    void CommandRegistry::setSubstringIndex(bool enabled) {
+        std::unique_lock<std::shared_mutex> lock(indexMutex_);
+        index_.setSubstringIndex(enabled);
+    }
+
+    void CommandRegistry::findPrefix(std::string_view prefix, Names &names) const {
+        CommandIndex::Matches matches;
+        std::shared_lock<std::shared_mutex> lock(indexMutex_);
+        index_.findPrefix(prefix, matches);
+        copy(matches, names);
+    }
+
+    void CommandRegistry::findSubstring(std::string_view text, Names &names) const {
+        CommandIndex::Matches matches;
+        std::shared_lock<std::shared_mutex> lock(indexMutex_);
+        index_.findSubstring(text, matches);
+        copy(matches, names);
+    }
+
+    CommandRegistry::Shard &CommandRegistry::shardOf(std::string_view name) const {
+        return shards_[shardIndex(name)];
+    }
+
+    std::size_t CommandRegistry::shardIndex(std::string_view name) const {
+        return std::hash<std::string_view>()(name) % shards_.size();
+    }
+
+    void CommandRegistry::copy(const CommandIndex::Matches &matches, Names &names) {
+        // The views are only valid under the index lock, so they are copied.
+        // Assigning reuses the strings left in names from previous calls.
+        names.resize(matches.size());
+        for (std::size_t i = 0; i < matches.size(); ++i) {
+            names[i].assign(matches[i].data(), matches[i].size());
+        }
+    }
+}
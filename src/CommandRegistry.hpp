@@ -0,0 +1,191 @@
+#ifndef CONSOLE_COMMAND_REGISTRY_HEADER_FILE
+#define CONSOLE_COMMAND_REGISTRY_HEADER_FILE
+
+#include "CommandIndex.hpp"
+#include "CompletionCache.hpp"
+#include "Console.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This struct holds everything the Console knows about a registered command.
+     *
+     * Commands are immutable once registered; replacing one registers a new
+     * Command, so a command being executed stays alive until it returns.
+     * Only the statistics change, while the Console records them.
+     */
+    struct Command {
+        using Handler = std::variant<std::function<int(const Console::Arguments &)>,
+                                     std::function<int(const Console::ArgumentViews &)>,
+                                     std::function<int(const Console::PmrArguments &)>>;
+
+        std::string name;
+        Handler handler;
+        std::vector<std::string> arguments;
+        bool async;
+        // Replaces arguments for completion, if set.
+        std::shared_ptr<CompletionCache> completion;
+        std::string description;
+        // Every recorded execution is counted in latency.
+        mutable LatencyHistogram latency{};
+        mutable std::atomic<std::uint64_t> errors{0};
+    };
+
+    /**
+     * @brief This struct holds the command line an alias stands for.
+     */
+    struct Alias {
+        std::string name;
+        std::string text;
+        // Views of text, replacing the alias on the lines using it.
+        std::vector<std::string_view> tokens;
+    };
+
+    /**
+     * @brief This class stores the registered commands of a Console.
+     *
+     * All functions can be called concurrently. The commands are spread over
+     * shards, each guarded by its own reader/writer lock. Writers hold a
+     * shard lock for single map operations, and the index lock for single
+     * index updates; these may allocate map entries and index nodes, but
+     * no user code runs under the locks, and replaced or erased commands
+     * are released after them. Lookups from different threads never wait
+     * on each other, and only wait on a writer touching the same shard.
+     *
+     * Batches lock all the shards they touch at once, in shard order, so
+     * that other threads see either none or all of a batch.
+     */
+    class CommandRegistry {
+    public:
+        using Pointer = std::shared_ptr<const Command>;
+        using AliasPointer = std::shared_ptr<const Alias>;
+        using Names = std::vector<std::string>;
+
+        CommandRegistry();
+
+        /**
+         * @brief This function adds a command, replacing any command with the same name.
+         */
+        void insert(Pointer command);
+
+        /**
+         * @brief This function adds several commands, updating the index once for all of them.
+         */
+        void insert(std::vector<Pointer> commands);
+
+        /**
+         * @brief This function removes a command.
+         *
+         * @return Whether the command was registered.
+         */
+        bool erase(std::string_view name);
+
+        /**
+         * @brief This function removes all commands whose names start with prefix.
+         *
+         * @return The number of commands removed.
+         */
+        std::size_t erasePrefix(std::string_view prefix);
+
+        /**
+         * @brief This function looks a command up by name.
+         *
+         * @return The command, or nullptr if it is not registered.
+         */
+        Pointer find(std::string_view name) const;
+
+        /**
+         * @brief This function returns a number which changes whenever the commands do.
+         */
+        std::uint64_t generation() const;
+
+        /**
+         * @brief This function returns the names of all commands, in sorted order.
+         */
+        Names names() const;
+
+        /**
+         * @brief This function returns the only command starting with prefix.
+         *
+         * @return The command, or nullptr if no or several commands start with prefix.
+         */
+        Pointer findUnique(std::string_view prefix) const;
+
+        /**
+         * @brief This function adds an alias, replacing any alias with the same name.
+         */
+        void insertAlias(AliasPointer alias);
+
+        /**
+         * @brief This function removes an alias.
+         *
+         * @return Whether the alias was defined.
+         */
+        bool eraseAlias(std::string_view name);
+
+        /**
+         * @brief This function looks an alias up by name.
+         *
+         * @return The alias, or nullptr if it is not defined.
+         */
+        AliasPointer findAlias(std::string_view name) const;
+
+        /**
+         * @brief This function enables or disables indexed substring completion.
+         */
+        void setSubstringIndex(bool enabled);
+
+        /**
+         * @brief This function replaces names with the commands starting with prefix.
+         */
+        void findPrefix(std::string_view prefix, Names &names) const;
+
+        /**
+         * @brief This function replaces names with the commands containing text.
+         */
+        void findSubstring(std::string_view text, Names &names) const;
+
+    private:
+        CommandRegistry(const CommandRegistry &) = delete;
+
+        CommandRegistry &operator=(const CommandRegistry &) = delete;
+
+        struct Shard {
+            mutable std::shared_mutex mutex;
+            // The keys are views of the names owned by the commands themselves,
+            // so lookups by views do not need to build a string first.
+            std::unordered_map<std::string_view, Pointer> commands;
+
+            Shard() : mutex(), commands() {}
+        };
+
+        Shard &shardOf(std::string_view name) const;
+
+        std::size_t shardIndex(std::string_view name) const;
+
+        static void copy(const CommandIndex::Matches &matches, Names &names);
+
+        mutable std::array<Shard, 16> shards_;
+        // Always locked after the shard of the command being changed.
+        mutable std::shared_mutex indexMutex_;
+        CommandIndex index_;
+        std::atomic<std::uint64_t> generation_;
+        mutable std::shared_mutex aliasMutex_;
+        // Keyed by views of the names owned by the aliases, like the commands.
+        std::unordered_map<std::string_view, AliasPointer> aliases_;
+    };
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "CompletionCache.hpp"
+
+#include <algorithm>
+
+namespace CppReadline {
+    CompletionCache::CompletionCache(Provider provider, std::chrono::milliseconds ttl)
+            : mutex_(), fetched_(), provider_(std::move(provider)), ttl_(ttl), candidates_(), fetchedAt_(),
+              fetching_(false), fetcher_() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        refresh();
+    }
+
+    CompletionCache::~CompletionCache() {
+        if (fetcher_.joinable()) { fetcher_.join(); }
+    }
+
+    void CompletionCache::findPrefix(std::string_view prefix, Names &names) {
+        auto matcher = candidates();
+        auto &all = matcher->candidates();
+        names.clear();
+        auto it = std::lower_bound(all.begin(), all.end(), prefix,
+                                   [](const std::string &name, std::string_view p) { return name < p; });
+        for (; it != all.end() && it->compare(0, prefix.size(), prefix) == 0; ++it) { names.push_back(*it); }
+    }
+
+    void CompletionCache::findSubstring(std::string_view text, Names &names) {
+        auto matcher = candidates();
+        names.clear();
+        for (auto &name : matcher->candidates()) {
+            if (name.find(text) != std::string::npos) { names.push_back(name); }
+        }
+    }
+
+    void CompletionCache::findFuzzy(std::string_view pattern, Names &names) {
+        candidates()->match(pattern, names);
+    }
+
+    void CompletionCache::invalidate() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fetchedAt_ = std::chrono::steady_clock::time_point();
+    }
+
+    CompletionCache::Candidates CompletionCache::candidates() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (std::chrono::steady_clock::now() - fetchedAt_ >= ttl_) { refresh(); }
+        // Nothing to offer yet, so the first fetch is waited for.
+        fetched_.wait(lock, [this] { return candidates_ || !fetching_; });
+        if (!candidates_) { candidates_ = std::make_shared<const FuzzyMatcher>(); }
+        return candidates_;
+    }
+
+    void CompletionCache::refresh() {
+        if (fetching_) { return; }
+        // The previous fetch is done, its thread has nothing left to lock.
+        if (fetcher_.joinable()) { fetcher_.join(); }
+        fetching_ = true;
+        fetcher_ = std::thread([this] {
+            Candidates fetched;
+            try {
+                auto names = provider_();
+                std::sort(names.begin(), names.end());
+                names.erase(std::unique(names.begin(), names.end()), names.end());
+                fetched = std::make_shared<const FuzzyMatcher>(std::move(names));
+            } catch (...) {
+                // Keep using the previous candidates.
+                fetched.reset();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (fetched) { candidates_ = std::move(fetched); }
+                fetchedAt_ = std::chrono::steady_clock::now();
+                fetching_ = false;
+            }
+            fetched_.notify_all();
+        });
+    }
+}
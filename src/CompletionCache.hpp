@@ -0,0 +1,91 @@
+#ifndef CONSOLE_COMPLETION_CACHE_HEADER_FILE
+#define CONSOLE_COMPLETION_CACHE_HEADER_FILE
+
+#include "FuzzyMatcher.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class keeps the argument candidates returned by a completion provider.
+     *
+     * The candidates are stored sorted, so prefix lookups only touch the
+     * matching ones. They are fetched on a background thread, first right
+     * away, then whenever they are used while older than the time to live.
+     * Until the new ones arrive the old ones are used, so completion never
+     * waits on the provider except for the very first fetch.
+     *
+     * All functions can be called concurrently.
+     */
+    class CompletionCache {
+    public:
+        using Provider = std::function<std::vector<std::string>()>;
+        using Names = std::vector<std::string>;
+
+        /**
+         * @brief Basic constructor, starts fetching the candidates.
+         *
+         * @param provider Returns the candidates, in any order.
+         * @param ttl How long fetched candidates are used before fetching them again.
+         */
+        CompletionCache(Provider provider, std::chrono::milliseconds ttl);
+
+        /**
+         * @brief Basic destructor, waits for a fetch in progress.
+         */
+        ~CompletionCache();
+
+        /**
+         * @brief This function replaces names with the candidates starting with prefix, in sorted order.
+         */
+        void findPrefix(std::string_view prefix, Names &names);
+
+        /**
+         * @brief This function replaces names with the candidates containing text, in sorted order.
+         */
+        void findSubstring(std::string_view text, Names &names);
+
+        /**
+         * @brief This function replaces names with the candidates fuzzily matching pattern, best first.
+         */
+        void findFuzzy(std::string_view pattern, Names &names);
+
+        /**
+         * @brief This function makes the next lookup fetch the candidates again.
+         */
+        void invalidate();
+
+    private:
+        CompletionCache(const CompletionCache &) = delete;
+
+        CompletionCache &operator=(const CompletionCache &) = delete;
+
+        // Sorted, with the masks the fuzzy matching needs.
+        using Candidates = std::shared_ptr<const FuzzyMatcher>;
+
+        // Returns the current candidates, fetching new ones if needed.
+        Candidates candidates();
+
+        // Must be called with the mutex held.
+        void refresh();
+
+        std::mutex mutex_;
+        std::condition_variable fetched_;
+        Provider provider_;
+        std::chrono::milliseconds ttl_;
+        Candidates candidates_;
+        std::chrono::steady_clock::time_point fetchedAt_;
+        bool fetching_;
+        std::thread fetcher_;
+    };
+}
+
+#endif
@@ -1,38 +1,234 @@
 #include "Console.hpp"
+#include "CommandRegistry.hpp"
+#include "FileCompleter.hpp"
+#include "FuzzyMatcher.hpp"
+#include "HistoryFile.hpp"
+#include "HistoryIndex.hpp"
+#include "LineScanner.hpp"
+#include "ScriptCache.hpp"
+#include "SessionLog.hpp"
+#include "ThreadPool.hpp"
+#include "TraceSink.hpp"
+#include "Tokenizer.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <functional>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <iterator>
-#include <sstream>
-#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <variant>
 
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <poll.h>
+#include <unistd.h>
+// Makes readline declare rl_message with its arguments.
+#define USE_VARARGS
+#define PREFER_STDARG
 #include <readline/readline.h>
 #include <readline/history.h>
 
 namespace CppReadline {
     namespace {
 
+        // Only touched by the thread driving readline.
         Console *currentConsole = nullptr;
-        HISTORY_STATE *emptyHistory = history_get_history_state();
+        // Installed while no Console owns the readline history.
+        HISTORY_STATE emptyHistory = HISTORY_STATE();
+
+        // Input which is not a terminal is read without readline, in large
+        // blocks. Shared by all Consoles, so that none of them loses lines
+        // another one has buffered. Only touched by the thread driving readline.
+        struct BatchInput {
+            int fd;
+            bool interactive;
+            LineScanner scanner;
+
+            BatchInput() : fd(-1), interactive(true), scanner() {}
+        };
+        BatchInput batchInput;
+
+        // Scratch space of a single executeCommand call. Commands can execute
+        // other commands (e.g. "run"), so every nesting level gets its own.
+        struct Frame {
+            Tokenizer tokenizer;
+            Console::Arguments arguments;
+            // The arena of the PmrArguments. Released after each command,
+            // its memory goes back to the pool, which keeps it for the next.
+            std::array<std::byte, 4096> buffer;
+            std::pmr::unsynchronized_pool_resource pool;
+            std::pmr::monotonic_buffer_resource arena;
+
+            Frame() : tokenizer(), arguments(), buffer(), pool(), arena(buffer.data(), buffer.size(), &pool) {}
+        };
+
+        // Each thread executing commands keeps its own frames. A deque, since
+        // pushing new levels must not move the ones in use.
+        thread_local std::deque<Frame> frames;
+        thread_local std::size_t depth = 0;
+
+        // A command line executed asynchronously on the worker threads.
+        struct Job {
+            enum State {
+                Queued,
+                Running,
+                Done,
+                Cancelled
+            };
+
+            int id;
+            ::std::string command;
+            ::std::atomic<bool> cancelled;
+            // Guarded by the jobs mutex of the Console, except that the result
+            // is written by the running job before it is marked finished.
+            State state;
+            int result;
+            // Only touched by the running job, and read once it finished.
+            StringSink output;
+
+            Job(int i, std::string_view c) : id(i), command(c), cancelled(false), state(Queued), result(0), output() {}
+        };
+
+        // The job running on this thread, if any, and where its output goes.
+        thread_local Job *currentJob = nullptr;
+        thread_local OutputSink *outputOverride = nullptr;
+        // Set while this thread runs the stages of a pipeline. Their output
+        // feeds the next stage, so async commands run inline meanwhile.
+        thread_local bool pipelineStage = false;
+        // Set while a script runs with ScriptOptions::json on this thread.
+        thread_local bool structuredScript = false;
+        // Handed to the commands running on this thread by getRecordWriter.
+        thread_local RecordWriter recordWriter;
+
+        // Whether this thread is waiting for input at a readline prompt.
+        thread_local bool promptShown = false;
+
+        // Writes the events dumped by "trace dump", as a table or as records.
+        class TraceTable : public TraceSink {
+        public:
+            TraceTable(OutputSink &output, RecordWriter &records)
+                    : output_(output), records_(records), origin_(0) {}
+
+            void record(const TraceEvent &event) override {
+                // Times are relative to the oldest event, which may have
+                // ended after spans it contains.
+                if (!origin_) { origin_ = event.start; }
+                double start = (static_cast<double>(event.start) - static_cast<double>(origin_)) * 1e-9;
+                if (records_.isEnabled()) {
+                    records_.begin().field("name", event.name).field("thread", event.thread).field("start", start)
+                            .field("duration", event.duration * 1e-9).field("detail", event.detail).end();
+                    return;
+                }
+                output_ << event.thread << '\t' << start * 1e6 << '\t' << event.duration * 1e-3 << '\t'
+                        << event.name << '\t' << event.detail << '\n';
+            }
+
+        private:
+            OutputSink &output_;
+            RecordWriter &records_;
+            std::uint64_t origin_;
+        };
 
     }  /* namespace  */
 
     struct Console::Impl {
-        using RegisteredCommands = std::unordered_map<std::string, Console::CommandFunction>;
-
         ::std::string greeting_;
         // These are hardcoded commands. They do not do anything and are catched manually in the executeCommand function.
-        RegisteredCommands commands_;
-        HISTORY_STATE *history_ = nullptr;
+        CommandRegistry commands_;
+        ::std::atomic<CompletionMode> completionMode_{CompletionMode::Prefix};
+        // Matches of the completion in progress, handed out one per call.
+        CommandRegistry::Names completions_;
+        ::std::size_t completionsIndex_ = 0;
+        // The command names for fuzzy completion, rebuilt when the commands change.
+        mutable ::std::mutex fuzzyCommandsMutex_;
+        mutable ::std::shared_ptr<const FuzzyMatcher> fuzzyCommands_;
+        mutable ::std::uint64_t fuzzyGeneration_ = 0;
+        // The sorted command names handed out by getCommandNames.
+        mutable ::std::mutex namesMutex_;
+        mutable Console::CommandNames names_;
+        mutable ::std::uint64_t namesGeneration_ = 0;
+        // The directory listings for arguments completed as filenames.
+        mutable FileCompleter files_;
+        // The history of this Console while another one uses readline. Only
+        // the pointers are swapped in and out, the entries stay in place.
+        HISTORY_STATE history_ = HISTORY_STATE();
+        ::std::size_t historyLimit_ = 0;
+        HistoryFile historyFile_;
+        // Whether the history file still has to be read into the history.
+        bool historyPending_ = false;
+        // A copy of the history searched by "history grep" and Ctrl-R, if enabled.
+        ::std::atomic<bool> indexHistory_;
+        HistoryIndex historyIndex_;
+        std::shared_ptr<OutputSink> output_;
+        // Read by every thread executing commands, so they may change meanwhile.
+        ::std::atomic<bool> quiet_{false};
+        ::std::atomic<bool> structured_{false};
+        ::std::atomic<bool> chaining_;
+        ::std::atomic<bool> abbreviations_;
+        bool mappedScripts_ = true;
+        bool preprocessScripts_ = false;
+        ::std::mutex scriptStatisticsMutex_;
+        ScriptStatistics scriptStatistics_;
+        ::std::atomic<bool> cacheScripts_;
+        ScriptCache scripts_;
+        ::std::atomic<bool> recordStatistics_;
+        ::std::atomic<bool> hasAsyncCommands_;
+        ::std::mutex jobsMutex_;
+        ::std::condition_variable jobsChanged_;
+        // All jobs which have not been reported yet.
+        ::std::map<int, std::shared_ptr<Job>> jobs_;
+        ::std::deque<std::shared_ptr<Job>> finishedJobs_;
+        int nextJobId_ = 1;
+        ::std::atomic<int> lastJobId_;
+        ::std::size_t workerThreads_ = std::max(1u, std::thread::hardware_concurrency());
+        // Where the input lines are recorded, if anywhere.
+        ::std::shared_ptr<SessionRecorder> recorder_;
+        // Set while the readline callback interface reads input for this Console.
+        bool inputInstalled_ = false;
+        bool lineDone_ = false;
+        int lineResult_ = ReturnCode::Ok;
+        // The sink the hooks trace to, nullptr while not tracing.
+        ::std::atomic<TraceSink *> tracer_;
+        mutable ::std::mutex traceMutex_;
+        // Every sink set so far, see setTraceSink, and those of "trace".
+        ::std::vector<std::shared_ptr<TraceSink>> traceSinks_;
+        ::std::shared_ptr<TraceRing> traceRing_;
+        ::std::shared_ptr<ChromeTraceSink> traceFile_;
+        // Last, so that it is gone before the jobs lose what they use.
+        ::std::unique_ptr<ThreadPool> pool_;
 
-        Impl(::std::string const &greeting) : greeting_(greeting), commands_() {}
+        Impl(::std::string const &greeting) : greeting_(greeting), commands_(), completions_(),
+                                                fuzzyCommandsMutex_(), fuzzyCommands_(), namesMutex_(), names_(), files_(),
+                                                historyFile_(), indexHistory_(false), historyIndex_(),
+                                                output_(std::make_shared<StreamSink>(std::cout)), chaining_(false),
+                                                abbreviations_(false),
+                                                scriptStatisticsMutex_(), scriptStatistics_(),
+                                                cacheScripts_(false), scripts_(), recordStatistics_(false),
+                                                hasAsyncCommands_(false), jobsMutex_(), jobsChanged_(),
+                                                jobs_(), finishedJobs_(), lastJobId_(0), recorder_(), tracer_(nullptr),
+                                                traceMutex_(), traceSinks_(), traceRing_(), traceFile_(), pool_() {}
 
         ~Impl() {
-            free(history_);
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex_);
+                for (auto &job : jobs_) { job.second->cancelled = true; }
+            }
+            // Waits for the running jobs. The queued ones return right away.
+            pool_.reset();
+            output_->flush();
+            for (int i = 0; i < history_.length; ++i) { free_history_entry(history_.entries[i]); }
+            free(history_.entries);
         }
 
         Impl(Impl const &) = delete;
@@ -42,6 +238,680 @@ namespace CppReadline {
         Impl &operator=(Impl const &) = delete;
 
         Impl &operator=(Impl &&) = delete;
+
+        void insertCommand(const std::string &name, Command::Handler handler, std::vector<std::string> arguments,
+                           CommandOptions options = CommandOptions()) {
+            commands_.insert(makeCommand(name, std::move(handler), std::move(arguments), std::move(options)));
+        }
+
+        CommandRegistry::Pointer makeCommand(std::string name, Command::Handler handler,
+                                             std::vector<std::string> arguments, CommandOptions options) {
+            if (options.async) { hasAsyncCommands_ = true; }
+            // The statistics make commands immovable, so they are built in place.
+            std::shared_ptr<CompletionCache> completion;
+            if (options.completion) {
+                completion = std::make_shared<CompletionCache>(std::move(options.completion), options.completionTtl);
+            }
+            return CommandRegistry::Pointer(new Command{std::move(name), std::move(handler), std::move(arguments),
+                                                        options.async, std::move(completion),
+                                                        std::move(options.description)});
+        }
+
+        static CommandOptions described(std::string description) {
+            CommandOptions options;
+            options.description = std::move(description);
+            return options;
+        }
+
+        TraceSink *tracer() const {
+            return CPP_READLINE_TRACING ? tracer_.load(std::memory_order_acquire) : nullptr;
+        }
+
+        // Expects the trace mutex to be held.
+        void setTracer(std::shared_ptr<TraceSink> sink) {
+            if (auto *previous = tracer_.load()) { previous->flush(); }
+            // A trace file of "trace" is complete once something else is traced to.
+            if (traceFile_ && traceFile_ != sink) {
+                traceFile_->close();
+                traceFile_.reset();
+            }
+            tracer_ = sink.get();
+            if (sink && std::find(traceSinks_.begin(), traceSinks_.end(), sink) == traceSinks_.end()) {
+                traceSinks_.push_back(std::move(sink));
+            }
+        }
+
+        // Shared by all callers until the commands change.
+        Console::CommandNames names() const {
+            std::lock_guard<std::mutex> lock(namesMutex_);
+            // Taken first, so that changes while listing cause a rebuild next time.
+            auto generation = commands_.generation();
+            if (!names_ || namesGeneration_ != generation) {
+                names_ = std::make_shared<const std::vector<std::string>>(commands_.names());
+                namesGeneration_ = generation;
+            }
+            return names_;
+        }
+
+        // The following act on the readline history, so the Console must own it.
+        void applyHistoryLimit() {
+            if (historyLimit_) {
+                stifle_history(static_cast<int>(std::min<std::size_t>(historyLimit_, INT_MAX)));
+            } else {
+                unstifle_history();
+            }
+        }
+
+        void loadHistory() {
+            historyPending_ = false;
+            ::std::string entry;
+            historyFile_.load(historyLimit_, [this, &entry](std::string_view line) {
+                entry.assign(line.data(), line.size());
+                add_history(entry.c_str());
+                if (indexHistory_) { historyIndex_.add(line); }
+            });
+        }
+
+        void bindHistorySearch() {
+            rl_bind_key(CTRL('R'), indexHistory_ ? &Console::historySearch : &rl_reverse_search_history);
+        }
+
+        void compactHistory() {
+            HistoryFile::Entries entries;
+            if (auto **list = history_list()) {
+                entries.reserve(static_cast<std::size_t>(history_length));
+                for (int i = 0; i < history_length; ++i) { entries.emplace_back(list[i]->line); }
+            }
+            historyFile_.compact(entries);
+        }
+
+        // Where the commands currently executing on this thread write to.
+        OutputSink &output() const {
+            return outputOverride ? *outputOverride : *output_;
+        }
+
+        bool structured() const {
+            return structured_ || structuredScript;
+        }
+
+        // The writer of the current command, disabled without structured output.
+        RecordWriter &records() const {
+            recordWriter.setSink(structured() ? &output() : nullptr);
+            return recordWriter;
+        }
+
+        // Reports a command of a script before it runs, unless quiet.
+        void reportCommand(std::size_t index, std::string_view command) const {
+            if (!quiet_ && !structured()) { output() << "[" << index << "] " << command << '\n'; }
+        }
+
+        // Reports how a command of a script went. With structured output each
+        // gets a record, which also takes the place of reportCommand.
+        void reportResult(std::size_t index, std::string_view command, int result) const {
+            if (structured()) {
+                records().begin().field("line", index).field("command", command).field("result", result).end();
+            } else if (!quiet_ && !result) {
+                output() << '\n';
+            }
+        }
+
+        void startJob(Console &console, std::string_view command) {
+            std::shared_ptr<Job> job;
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex_);
+                job = std::make_shared<Job>(nextJobId_++, command);
+                jobs_.emplace(job->id, job);
+                if (!pool_) { pool_.reset(new ThreadPool(workerThreads_)); }
+                lastJobId_ = job->id;
+                // Submitted under the lock, since setWorkerThreads may replace the pool.
+                pool_->submit([this, &console, job] { runJob(console, job); });
+            }
+            output() << "[" << job->id << "] " << command << '\n';
+        }
+
+        void runJob(Console &console, const std::shared_ptr<Job> &job) {
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex_);
+                // Already reported as cancelled by the cancel command.
+                if (job->state != Job::Queued) { return; }
+                job->state = Job::Running;
+            }
+            if (!job->cancelled) {
+                currentJob = job.get();
+                outputOverride = &job->output;
+                job->result = console.executeCommand(job->command);
+                currentJob = nullptr;
+                outputOverride = nullptr;
+            } else {
+                job->result = ReturnCode::Error;
+            }
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex_);
+                job->state = job->cancelled ? Job::Cancelled : Job::Done;
+                finishedJobs_.push_back(job);
+            }
+            jobsChanged_.notify_all();
+        }
+
+        int executeParallel(Console &console, LineScanner &input, std::size_t threads, ScriptStatistics &statistics) {
+            // Buffered lines are overwritten by the next one read, so copy them.
+            std::string copies;
+            std::vector<std::pair<std::size_t, std::size_t>> copied;
+            std::vector<std::string_view> commands;
+            std::string_view command;
+            while (input.next(command)) {
+                ++statistics.lines;
+                if (!command.empty() && command[0] == '#') { continue; } // Ignore comments
+                if (input.isMapped()) {
+                    commands.push_back(command);
+                } else {
+                    copied.emplace_back(copies.size(), command.size());
+                    copies.append(command.data(), command.size());
+                }
+            }
+            for (auto &line : copied) { commands.emplace_back(copies.data() + line.first, line.second); }
+
+            return runParallel(commands.size(), threads, statistics,
+                               [&](std::size_t i) { return commands[i]; },
+                               [&](std::size_t i) { return console.executeCommand(commands[i]); });
+        }
+
+        int executeCompiled(Console &console, const CompiledScript &script, std::size_t threads,
+                            ScriptStatistics &statistics) {
+            statistics.lines = script.lineCount;
+            auto run = [&](std::size_t i) {
+                auto &line = script.lines[i];
+                if (line.tokens.empty()) { return static_cast<int>(ReturnCode::Ok); }
+                // The tokens of chained lines span several commands.
+                if (chaining_ && isChained(line.text)) { return console.executeCommand(line.text); }
+                return execute(console, line.text, line.tokens, line.command.get());
+            };
+            if (threads > 1) {
+                if (script.steps.empty()) {
+                    return runParallel(script.lines.size(), threads, statistics,
+                                       [&](std::size_t i) { return script.lines[i].text; }, run);
+                }
+                // The workers need to know which line comes at which position.
+                std::vector<std::size_t> order;
+                unroll(script.steps, 0, script.steps.size(), order);
+                return runParallel(order.size(), threads, statistics,
+                                   [&](std::size_t i) { return script.lines[order[i]].text; },
+                                   [&](std::size_t i) { return run(order[i]); });
+            }
+
+            std::size_t counter = 0;
+            auto step = [&](std::size_t i) {
+                auto text = script.lines[i].text;
+                // Report what the Console is executing.
+                reportCommand(counter, text);
+                ++statistics.commands;
+                int result = run(i);
+                reportResult(counter++, text, result);
+                return result;
+            };
+            if (script.steps.empty()) {
+                for (std::size_t i = 0; i < script.lines.size(); ++i) {
+                    if (int result = step(i)) { return result; }
+                }
+                // If we arrived successfully at the end, all is ok
+                return ReturnCode::Ok;
+            }
+            return runSteps(script.steps, 0, script.steps.size(), step);
+        }
+
+        // Runs the steps in [begin, end) of a preprocessed script, calling
+        // step(line) for each line, and stops at the first failing one.
+        template <typename Step>
+        int runSteps(const std::vector<PreprocessedScript::Step> &steps, std::size_t begin, std::size_t end,
+                     Step &step) {
+            Job *job = currentJob;
+            for (std::size_t i = begin; i < end; ++i) {
+                auto &current = steps[i];
+                if (!current.isRepeat()) {
+                    if (int result = step(current.line)) { return result; }
+                    continue;
+                }
+                for (std::size_t n = 0; n < current.line; ++n) {
+                    if (job && job->cancelled) { return ReturnCode::Error; }
+                    if (int result = runSteps(steps, i + 1, current.end, step)) { return result; }
+                }
+                i = current.end - 1;
+            }
+            return ReturnCode::Ok;
+        }
+
+        // Appends the lines the steps in [begin, end) run, in order.
+        static void unroll(const std::vector<PreprocessedScript::Step> &steps, std::size_t begin, std::size_t end,
+                           std::vector<std::size_t> &order) {
+            for (std::size_t i = begin; i < end; ++i) {
+                auto &current = steps[i];
+                if (!current.isRepeat()) {
+                    order.push_back(current.line);
+                    continue;
+                }
+                for (std::size_t n = 0; n < current.line; ++n) { unroll(steps, i + 1, current.end, order); }
+                i = current.end - 1;
+            }
+        }
+
+        // Runs count independent commands on multiple threads, reporting
+        // them in order. text(i) returns the line of the i-th command, and
+        // run(i) executes it.
+        template <typename Text, typename Run>
+        int runParallel(std::size_t count, std::size_t threads, ScriptStatistics &statistics, Text text, Run run) {
+            struct Line {
+                StringSink output;
+                int result = ReturnCode::Ok;
+                bool done = false;
+                // Thrown by the command, rethrown on the calling thread.
+                std::exception_ptr exception;
+
+                Line() : output(), exception() {}
+            };
+            std::vector<Line> lines(count);
+            std::mutex mutex;
+            std::condition_variable lineDone;
+            std::atomic<std::size_t> next(0);
+            std::atomic<bool> stop(false);
+            threads = std::min(threads, lines.size());
+            // Guarded by mutex, like the state of the lines.
+            std::size_t active = threads;
+
+            // The workers act on behalf of the job running this script, if any.
+            Job *job = currentJob;
+            bool structured = structuredScript;
+            auto work = [&] {
+                currentJob = job;
+                structuredScript = structured;
+                std::size_t i;
+                while (!stop && !(job && job->cancelled) && (i = next++) < lines.size()) {
+                    outputOverride = &lines[i].output;
+                    int result = ReturnCode::Error;
+                    std::exception_ptr exception;
+                    try {
+                        result = run(i);
+                    } catch (...) {
+                        exception = std::current_exception();
+                    }
+                    // Lines are claimed in order, so all lines before this one
+                    // are already running and still get reported.
+                    if (result != ReturnCode::Ok) { stop = true; }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        lines[i].result = result;
+                        lines[i].exception = std::move(exception);
+                        lines[i].done = true;
+                    }
+                    lineDone.notify_all();
+                }
+                outputOverride = nullptr;
+                currentJob = nullptr;
+                structuredScript = false;
+                // Unblock the reporting loop waiting for lines never started.
+                std::lock_guard<std::mutex> lock(mutex);
+                --active;
+                lineDone.notify_all();
+            };
+
+            std::vector<std::thread> workers;
+            for (std::size_t i = 0; i < threads; ++i) { workers.emplace_back(work); }
+            struct Join {
+                std::vector<std::thread> &workers;
+                std::atomic<bool> &stop;
+                ~Join() {
+                    stop = true;
+                    for (auto &worker : workers) { worker.join(); }
+                }
+            } join{workers, stop};
+
+            auto &out = output();
+            for (std::size_t i = 0; i < lines.size(); ++i) {
+                auto &line = lines[i];
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    lineDone.wait(lock, [&] { return line.done || active == 0; });
+                    if (!line.done) { break; }
+                }
+                // Report what the Console executed.
+                reportCommand(i, text(i));
+                out << line.output.str();
+                line.output = StringSink();
+                // Like executing the line here, after the lines before it.
+                if (line.exception) {
+                    stop = true;
+                    std::rethrow_exception(line.exception);
+                }
+                ++statistics.commands;
+                reportResult(i, text(i), line.result);
+                if (line.result) {
+                    stop = true;
+                    return line.result;
+                }
+            }
+            if (job && job->cancelled) { return ReturnCode::Error; }
+
+            // If we arrived successfully at the end, all is ok
+            return ReturnCode::Ok;
+        }
+
+        void completeCommand(std::string_view text, CommandRegistry::Names &matches) const {
+            if (completionMode_ == CompletionMode::Fuzzy) {
+                std::shared_ptr<const FuzzyMatcher> matcher;
+                {
+                    std::lock_guard<std::mutex> lock(fuzzyCommandsMutex_);
+                    auto generation = commands_.generation();
+                    if (!fuzzyCommands_ || fuzzyGeneration_ != generation) {
+                        fuzzyCommands_ = std::make_shared<const FuzzyMatcher>(*names());
+                        fuzzyGeneration_ = generation;
+                    }
+                    matcher = fuzzyCommands_;
+                }
+                matcher->match(text, matches);
+            } else if (completionMode_ == CompletionMode::Substring) {
+                commands_.findSubstring(text, matches);
+            } else {
+                commands_.findPrefix(text, matches);
+                collapseNamespaces(text, matches);
+            }
+        }
+
+        // Replaces the names below the next namespace level by the namespace,
+        // e.g. "db.table.list" by "db.table." when completing "db.". The
+        // matches are sorted, so the names of a namespace are adjacent.
+        static void collapseNamespaces(std::string_view text, CommandRegistry::Names &matches) {
+            bool collapsed = false;
+            for (auto &match : matches) {
+                auto dot = match.find('.', text.size());
+                if (dot != std::string::npos && dot + 1 < match.size()) {
+                    match.resize(dot + 1);
+                    collapsed = true;
+                }
+            }
+            if (collapsed) { matches.erase(std::unique(matches.begin(), matches.end()), matches.end()); }
+        }
+
+        // Returns false if the command is unknown, or readline should complete
+        // the filename itself. Sets filenames if the matches are paths.
+        bool completeArgument(std::string_view line, std::string_view text, CommandRegistry::Names &matches,
+                              bool *filenames = nullptr) const {
+            matches.clear();
+            // Kept, so that splitting the line reuses its storage.
+            thread_local Tokenizer tokenizer;
+            auto &tokens = tokenizer.tokenize(line);
+            auto command = tokens.empty() ? nullptr : commands_.find(tokens[0]);
+            if (!command) { return false; }
+
+            auto given = [&tokens, text](const std::string &param) {
+                // The word being completed may already be one of the tokens.
+                for (std::size_t i = 1; i < tokens.size(); ++i) {
+                    if (tokens[i] == param && tokens[i] != text) { return true; }
+                }
+                return false;
+            };
+
+            if (auto &completion = command->completion) {
+                switch (completionMode_) {
+                    case CompletionMode::Prefix: completion->findPrefix(text, matches); break;
+                    case CompletionMode::Substring: completion->findSubstring(text, matches); break;
+                    case CompletionMode::Fuzzy: completion->findFuzzy(text, matches); break;
+                }
+                // Skip arguments which have already been given.
+                matches.erase(std::remove_if(matches.begin(), matches.end(), given), matches.end());
+                return true;
+            }
+
+            auto &params = command->arguments;
+            if (!params.empty() && params.at(0) == Console::COMPLETE_FILE) {
+                // Only readline knows the home directories.
+                if (!text.empty() && text[0] == '~') { return false; }
+                // The remaining arguments are the extensions to offer.
+                thread_local FileCompleter::Extensions extensions;
+                extensions.assign(params.begin() + 1, params.end());
+                files_.complete(text, extensions, matches);
+                if (filenames) { *filenames = true; }
+                return true;
+            }
+
+            if (completionMode_ == CompletionMode::Fuzzy) {
+                FuzzyMatcher(params).match(text, matches);
+                matches.erase(std::remove_if(matches.begin(), matches.end(), given), matches.end());
+                return true;
+            }
+
+            for (auto &param : params) {
+                if (param.find(text) == std::string::npos) { continue; }
+                // Skip arguments which have already been given.
+                if (!given(param)) { matches.push_back(param); }
+            }
+            return true;
+        }
+
+        bool hasFinishedJobs() {
+            std::lock_guard<std::mutex> lock(jobsMutex_);
+            return !finishedJobs_.empty();
+        }
+
+        int dispatch(const Command &command, const ArgumentViews &tokens, Frame &frame) {
+            if (auto *f = std::get_if<std::function<int(const ArgumentViews &)>>(&command.handler)) {
+                return (*f)(tokens);
+            }
+            if (auto *f = std::get_if<std::function<int(const PmrArguments &)>>(&command.handler)) {
+                int result;
+                {
+                    PmrArguments arguments(&frame.arena);
+                    arguments.reserve(tokens.size());
+                    for (auto token : tokens) { arguments.emplace_back(token); }
+                    result = (*f)(arguments);
+                }
+                frame.arena.release();
+                return result;
+            }
+            // Assigning keeps the capacity of the strings left over by
+            // previous calls, so this only allocates for longer arguments.
+            auto &arguments = frame.arguments;
+            arguments.resize(tokens.size());
+            for (std::size_t i = 0; i < tokens.size(); ++i) {
+                arguments[i].assign(tokens[i].data(), tokens[i].size());
+            }
+            return std::get<std::function<int(const Arguments &)>>(command.handler)(arguments);
+        }
+
+        static bool isChained(std::string_view line) {
+            return line.find_first_of(";&|") != std::string_view::npos;
+        }
+
+        // Executes a line holding a single command.
+        int executeLine(Console &console, std::string_view line) {
+            if (depth == frames.size()) { frames.emplace_back(); }
+
+            auto *sink = tracer();
+            // Convert input to tokens
+            TraceScope tokenizing(sink, "tokenize");
+            auto &inputs = frames[depth].tokenizer.tokenize(line);
+            tokenizing.end();
+            if (inputs.size() == 0) { return ReturnCode::Ok; }
+
+            // Holding the command keeps it alive even if it gets replaced meanwhile.
+            TraceScope lookup(sink, "lookup");
+            auto found = commands_.find(inputs[0]);
+            lookup.end();
+            return execute(console, line, inputs, found.get());
+        }
+
+        // Executes "a; b" and "a && b", where a and b may be pipelines.
+        int executeChain(Console &console, std::string_view line) {
+            int result = ReturnCode::Ok;
+            // The first pass only checks the line, so that a malformed one executes nothing.
+            for (bool check : {true, false}) {
+                bool run = true;
+                bool afterBoth = false;
+                std::size_t start = 0;
+                for (std::size_t i = 0; i <= line.size(); ++i) {
+                    bool end = i == line.size();
+                    bool both = !end && line[i] == '&' && i + 1 < line.size() && line[i + 1] == '&';
+                    if (!end && line[i] != ';' && !both) { continue; }
+
+                    auto pipeline = line.substr(start, i - start);
+                    bool blank = isBlank(pipeline);
+                    if (check && blank && (both || afterBoth)) {
+                        output() << "Missing command " << (both ? "before" : "after") << " '&&'.\n";
+                        return ReturnCode::Error;
+                    }
+                    // Empty commands, as in "a;" or "a; ; b", keep the result of the previous one.
+                    if (!check && run && !blank) {
+                        result = executePipeline(console, pipeline);
+                        if (result == ReturnCode::Quit) { return result; }
+                    }
+                    // After a failure everything up to the next ';' is skipped.
+                    run = both ? run && result == ReturnCode::Ok : true;
+                    afterBoth = both;
+                    if (both) { ++i; }
+                    start = i + 1;
+                }
+            }
+            return result;
+        }
+
+        // Executes "a | b", appending the words a writes to the arguments of b.
+        int executePipeline(Console &console, std::string_view pipeline) {
+            auto bar = pipeline.find('|');
+            if (bar == std::string_view::npos) { return executeLine(console, pipeline); }
+
+            // Each stage writes to one sink while the next reads the other.
+            StringSink sinks[2];
+            Tokenizer stage, words;
+            ArgumentViews tokens;
+            auto *target = outputOverride;
+            struct Restore {
+                OutputSink *previous;
+                bool stage;
+                ~Restore() {
+                    outputOverride = previous;
+                    pipelineStage = stage;
+                }
+            } restore{target, pipelineStage};
+            pipelineStage = true;
+
+            int result = ReturnCode::Ok;
+            std::size_t start = 0, current = 0;
+            for (bool first = true; ; first = false) {
+                bool last = bar == std::string_view::npos;
+                auto text = pipeline.substr(start, last ? std::string_view::npos : bar - start);
+                auto &typed = stage.tokenize(text);
+                if (typed.empty()) {
+                    outputOverride = target;
+                    output() << "Missing command in pipeline.\n";
+                    return ReturnCode::Error;
+                }
+                tokens.assign(typed.begin(), typed.end());
+                if (!first) {
+                    auto &piped = words.tokenize(sinks[1 - current].str());
+                    tokens.insert(tokens.end(), piped.begin(), piped.end());
+                }
+                sinks[current].clear();
+                outputOverride = last ? target : &sinks[current];
+
+                auto command = commands_.find(tokens[0]);
+                result = execute(console, text, tokens, command.get());
+                if (last) { break; }
+                if (result != ReturnCode::Ok) {
+                    // Show what the failing stage had to say.
+                    outputOverride = target;
+                    output() << sinks[current].str();
+                    break;
+                }
+                current = 1 - current;
+                start = bar + 1;
+                bar = pipeline.find('|', start);
+            }
+            return result;
+        }
+
+        static bool isBlank(std::string_view text) {
+            return std::all_of(text.begin(), text.end(), Tokenizer::isSeparator);
+        }
+
+        int notFound(std::string_view name) const {
+            if (structured()) {
+                records().begin().field("error", "Command not found").field("command", name).end();
+            } else {
+                output() << "Command '" << name << "' not found.\n";
+            }
+            return ReturnCode::Error;
+        }
+
+        // Executes a line whose first word is no command, but may be an alias
+        // or the abbreviation of one.
+        int executeResolved(Console &console, std::string_view line, const ArgumentViews &tokens) {
+            ArgumentViews expanded;
+            if (auto alias = commands_.findAlias(tokens[0])) {
+                expanded.reserve(alias->tokens.size() + tokens.size() - 1);
+                expanded.assign(alias->tokens.begin(), alias->tokens.end());
+                expanded.insert(expanded.end(), tokens.begin() + 1, tokens.end());
+                // Aliases of aliases are not expanded, so they cannot loop.
+                auto command = commands_.find(expanded[0]);
+                if (!command) { return notFound(expanded[0]); }
+                return execute(console, line, expanded, command.get());
+            }
+            if (!abbreviations_) { return notFound(tokens[0]); }
+
+            if (auto command = commands_.findUnique(tokens[0])) {
+                expanded.assign(tokens.begin(), tokens.end());
+                // Commands see the name they were registered with.
+                expanded[0] = command->name;
+                return execute(console, line, expanded, command.get());
+            }
+            CommandRegistry::Names candidates;
+            commands_.findPrefix(tokens[0], candidates);
+            if (candidates.empty()) { return notFound(tokens[0]); }
+            if (structured()) {
+                auto &records = this->records().begin().field("error", "Command is ambiguous")
+                                               .field("command", tokens[0]).key("candidates").beginArray();
+                for (auto &candidate : candidates) { records.value(candidate); }
+                records.endArray().end();
+            } else {
+                auto &out = output();
+                out << "Command '" << tokens[0] << "' is ambiguous:";
+                for (auto &candidate : candidates) { out << ' ' << candidate; }
+                out << '\n';
+            }
+            return ReturnCode::Error;
+        }
+
+        // Executes a line read as input, recording it if asked to.
+        int executeInput(Console &console, std::string_view line) {
+            // Taken first, so that "record" does not record itself.
+            auto recorder = recorder_;
+            if (!recorder) { return console.executeCommand(line); }
+            auto start = std::chrono::steady_clock::now();
+            int result = console.executeCommand(line);
+            recorder->record(line, result, start, std::chrono::steady_clock::now() - start);
+            return result;
+        }
+
+        // Executes an already tokenized, non empty line.
+        int execute(Console &console, std::string_view line, const ArgumentViews &tokens, const Command *command) {
+            if (!command) { return executeResolved(console, line, tokens); }
+            if (command->async && !currentJob && !pipelineStage) {
+                startJob(console, line);
+                return ReturnCode::Ok;
+            }
+            if (depth == frames.size()) { frames.emplace_back(); }
+            auto &frame = frames[depth++];
+            struct DepthGuard {
+                ~DepthGuard() { --depth; }
+            } guard;
+            TraceScope trace(tracer(), "handler", command->name);
+            if (!recordStatistics_.load(std::memory_order_relaxed)) { return dispatch(*command, tokens, frame); }
+
+            auto start = std::chrono::steady_clock::now();
+            int result = dispatch(*command, tokens, frame);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            command->latency.record(static_cast<std::uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            if (result > 0) { command->errors.fetch_add(1, std::memory_order_relaxed); }
+            return result;
+        }
     };
 
     // Here we set default commands, they do nothing since we quit with them
@@ -53,140 +923,919 @@ namespace CppReadline {
 
         // These are default hardcoded commands.
         // Help command lists available commands.
-        pimpl_->commands_["help"] = {[this](const Arguments &) {
-            auto commands = getRegisteredCommands();
-            std::cout << "Available commands are:\n";
-            for (auto &command : commands) { std::cout << "\t" << command << "\n"; }
-            return ReturnCode::Ok;
-        }, std::vector<std::string>()};
+        pimpl_->insertCommand("help", [this](const ArgumentViews &input) {
+            auto &impl = *pimpl_;
+            if (input.size() > 2) {
+                impl.output() << "Usage: " << input[0] << " [command]\n";
+                return static_cast<int>(ReturnCode::Error);
+            }
+            if (input.size() == 2) {
+                auto command = impl.commands_.find(input[1]);
+                if (!command) { return impl.notFound(input[1]); }
+                if (impl.structured()) {
+                    impl.records().begin().field("command", command->name)
+                                  .field("description", command->description).end();
+                } else {
+                    auto &output = impl.output();
+                    output << command->name << '\n';
+                    if (!command->description.empty()) { output << command->description << '\n'; }
+                }
+                return static_cast<int>(ReturnCode::Ok);
+            }
+
+            auto commands = impl.names();
+            if (impl.structured()) {
+                auto &records = impl.records().begin().key("commands").beginArray();
+                for (auto &command : *commands) { records.value(command); }
+                records.endArray().end();
+                return static_cast<int>(ReturnCode::Ok);
+            }
+            auto &output = impl.output();
+            output << "Available commands are:\n";
+            for (auto &name : *commands) {
+                output << "\t" << name;
+                // Unregistered meanwhile, or without description.
+                auto command = impl.commands_.find(name);
+                if (command && !command->description.empty()) {
+                    std::string_view description = command->description;
+                    output << "\t" << description.substr(0, description.find('\n'));
+                }
+                output << "\n";
+            }
+            return static_cast<int>(ReturnCode::Ok);
+        }, std::vector<std::string>(), Impl::described("Lists the commands, or describes one."));
         // Run command executes all commands in an external file.
-        pimpl_->commands_["run"] = {[this](const Arguments &input) {
-            if (input.size() < 2) {
-                std::cout << "Usage: " << input[0] << " script_filename\n";
+        pimpl_->insertCommand("run", [this](const Arguments &input) {
+            ScriptOptions options;
+            std::size_t file = 1;
+            while (file + 1 < input.size()) {
+                if (input[file] == "-j" && file + 2 < input.size()) {
+                    options.threads = static_cast<std::size_t>(std::max(1, std::atoi(input[file + 1].c_str())));
+                    file += 2;
+                } else if (input[file] == "--json") {
+                    options.json = true;
+                    ++file;
+                } else {
+                    break;
+                }
+            }
+            if (input.size() != file + 1) {
+                pimpl_->output() << "Usage: " << input[0] << " [-j threads] [--json] script_filename\n";
                 return 1;
             }
-            return executeFile(input[1]);
-        }, std::vector<std::string>{COMPLETE_FILE}};;
+            return executeFile(input[file], options);
+        }, std::vector<std::string>{COMPLETE_FILE},
+           Impl::described("Executes the commands in a file.\n"
+                           "Usage: run [-j threads] [--json] script_filename"));
+        // Jobs lists the async commands which have not been reported yet.
+        pimpl_->insertCommand("jobs", [this](const ArgumentViews &) {
+            auto &output = pimpl_->output();
+            std::lock_guard<std::mutex> lock(pimpl_->jobsMutex_);
+            for (auto &pair : pimpl_->jobs_) {
+                auto &job = *pair.second;
+                output << "[" << job.id << "] ";
+                switch (job.state) {
+                    case Job::Queued: output << "Queued"; break;
+                    case Job::Running: output << (job.cancelled ? "Cancelling" : "Running"); break;
+                    case Job::Done: output << "Done (" << job.result << ")"; break;
+                    case Job::Cancelled: output << "Cancelled"; break;
+                }
+                output << "\t" << job.command << "\n";
+            }
+            return ReturnCode::Ok;
+        }, std::vector<std::string>(), Impl::described("Lists the async commands which have not been reported yet."));
+        // Wait blocks until the given job, or all of them, finished.
+        pimpl_->insertCommand("wait", [this](const ArgumentViews &input) {
+            auto &impl = *pimpl_;
+            int result = ReturnCode::Ok;
+            {
+                std::unique_lock<std::mutex> lock(impl.jobsMutex_);
+                if (input.size() < 2) {
+                    impl.jobsChanged_.wait(lock, [&impl] {
+                        return std::all_of(impl.jobs_.begin(), impl.jobs_.end(), [](const auto &pair) {
+                            return pair.second->state >= Job::Done;
+                        });
+                    });
+                } else {
+                    auto it = impl.jobs_.find(std::atoi(std::string(input[1]).c_str()));
+                    if (it == impl.jobs_.end()) {
+                        lock.unlock();
+                        impl.output() << "No job " << input[1] << " to wait for.\n";
+                        return static_cast<int>(ReturnCode::Error);
+                    }
+                    auto job = it->second;
+                    impl.jobsChanged_.wait(lock, [&job] { return job->state >= Job::Done; });
+                    result = job->result;
+                }
+            }
+            reportFinishedJobs();
+            return result;
+        }, std::vector<std::string>(), Impl::described("Waits for a job, or for all jobs.\nUsage: wait [job_id]"));
+        // Cancel asks a job to stop. Queued jobs never start.
+        pimpl_->insertCommand("cancel", [this](const ArgumentViews &input) {
+            auto &impl = *pimpl_;
+            if (input.size() < 2) {
+                impl.output() << "Usage: " << input[0] << " job_id\n";
+                return static_cast<int>(ReturnCode::Error);
+            }
+            {
+                std::lock_guard<std::mutex> lock(impl.jobsMutex_);
+                auto it = impl.jobs_.find(std::atoi(std::string(input[1]).c_str()));
+                if (it != impl.jobs_.end() && it->second->state <= Job::Running) {
+                    auto &job = it->second;
+                    job->cancelled = true;
+                    if (job->state == Job::Queued) {
+                        job->state = Job::Cancelled;
+                        job->result = ReturnCode::Error;
+                        impl.finishedJobs_.push_back(job);
+                    }
+                    impl.jobsChanged_.notify_all();
+                    return static_cast<int>(ReturnCode::Ok);
+                }
+            }
+            impl.output() << "No job " << input[1] << " to cancel.\n";
+            return static_cast<int>(ReturnCode::Error);
+        }, std::vector<std::string>(), Impl::described("Cancels a job.\nUsage: cancel job_id"));
+        // History greps the history, newest matches last.
+        pimpl_->insertCommand("history", [this](const ArgumentViews &input) {
+            auto &impl = *pimpl_;
+            std::size_t count = 50, text = 2;
+            if (input.size() > 3 && input[2] == "-n") {
+                count = static_cast<std::size_t>(std::max(1, std::atoi(std::string(input[3]).c_str())));
+                text = 4;
+            }
+            if (input.size() <= text || input[1] != "grep") {
+                impl.output() << "Usage: " << input[0] << " grep [-n count] text\n";
+                return static_cast<int>(ReturnCode::Error);
+            }
+            if (!impl.indexHistory_) {
+                impl.output() << "The history is not indexed.\n";
+                return static_cast<int>(ReturnCode::Error);
+            }
+            // The words are searched as typed, separated by single spaces.
+            std::string pattern(input[text]);
+            for (std::size_t i = text + 1; i < input.size(); ++i) { pattern.append(" ").append(input[i]); }
+            HistoryIndex::Matches matches;
+            impl.historyIndex_.search(pattern, count, matches);
+            auto &output = impl.output();
+            for (auto it = matches.rbegin(); it != matches.rend(); ++it) {
+                output << '\t' << it->id + 1 << "  " << it->line << '\n';
+            }
+            return static_cast<int>(matches.empty() ? ReturnCode::Error : ReturnCode::Ok);
+        }, std::vector<std::string>{"grep"},
+           Impl::described("Searches the history.\n"
+                           "Usage: history grep [-n count] text"));
+        // Stats prints how often the commands ran and how long they took.
+        pimpl_->insertCommand("stats", [this](const ArgumentViews &input) {
+            auto &impl = *pimpl_;
+            if (input.size() > 1) {
+                if (input[1] == "on" || input[1] == "off") {
+                    setCommandStatistics(input[1] == "on");
+                } else if (input[1] == "reset") {
+                    resetCommandStatistics();
+                } else {
+                    impl.output() << "Usage: " << input[0] << " [on|off|reset]\n";
+                    return static_cast<int>(ReturnCode::Error);
+                }
+                return static_cast<int>(ReturnCode::Ok);
+            }
+            if (impl.structured()) {
+                auto &records = impl.records();
+                for (auto &command : getCommandStatistics()) {
+                    if (!command.calls) { continue; }
+                    records.begin().field("command", command.name).field("calls", command.calls)
+                           .field("errors", command.errors).field("mean", command.meanSeconds())
+                           .field("p50", command.quantile(0.5)).field("p99", command.quantile(0.99))
+                           .field("max", command.maxSeconds).end();
+                }
+                return static_cast<int>(ReturnCode::Ok);
+            }
+            auto &output = impl.output();
+            if (!impl.recordStatistics_) { output << "Statistics are not recorded, enable them with 'stats on'.\n"; }
+            output << "Command\tCalls\tErrors\tMean\tp50\tp99\tMax (microseconds)\n";
+            for (auto &command : getCommandStatistics()) {
+                if (!command.calls) { continue; }
+                output << command.name << '\t' << command.calls << '\t' << command.errors << '\t'
+                       << command.meanSeconds() * 1e6 << '\t' << command.quantile(0.5) * 1e6 << '\t'
+                       << command.quantile(0.99) * 1e6 << '\t' << command.maxSeconds * 1e6 << '\n';
+            }
+            return static_cast<int>(ReturnCode::Ok);
+        }, std::vector<std::string>{"on", "off", "reset"},
+           Impl::described("Shows how often the commands ran and how long they took.\n"
+                           "Usage: stats [on|off|reset]"));
+        pimpl_->insertCommand("record", [this](const Arguments &input) {
+            auto &impl = *pimpl_;
+            if (input.size() != 2) {
+                impl.output() << "Usage: " << input[0] << " <file>|off\n";
+                return static_cast<int>(ReturnCode::Error);
+            }
+            if (input[1] == "off") {
+                if (impl.recorder_) { impl.recorder_->close(); }
+                impl.recorder_.reset();
+                return static_cast<int>(ReturnCode::Ok);
+            }
+            auto recorder = std::make_shared<SessionRecorder>();
+            if (!recorder->open(input[1])) {
+                impl.output() << "Could not create the file '" << input[1] << "'.\n";
+                return static_cast<int>(ReturnCode::Error);
+            }
+            impl.recorder_ = std::move(recorder);
+            return static_cast<int>(ReturnCode::Ok);
+        }, std::vector<std::string>{"off"},
+           Impl::described("Records the commands entered into a session log, for SessionReplayer.\n"
+                           "Usage: record <file>|off"));
+        pimpl_->insertCommand("trace", [this](const Arguments &input) {
+            auto &impl = *pimpl_;
+            auto usage = [&] {
+                impl.output() << "Usage: " << input[0] << " [on [events]|off|chrome <file>|dump [file]]\n";
+                return static_cast<int>(ReturnCode::Error);
+            };
+            if (!CPP_READLINE_TRACING) {
+                impl.output() << "Tracing is compiled out.\n";
+                return static_cast<int>(ReturnCode::Error);
+            }
+            std::lock_guard<std::mutex> lock(impl.traceMutex_);
+            if (input.size() == 1) {
+                auto *current = impl.tracer_.load();
+                if (!current) {
+                    impl.output() << "Tracing is off.\n";
+                } else if (current == impl.traceRing_.get()) {
+                    impl.output() << "Tracing to the ring, " << impl.traceRing_->recorded() << " events so far.\n";
+                } else if (current == impl.traceFile_.get()) {
+                    impl.output() << "Tracing to a file.\n";
+                } else {
+                    impl.output() << "Tracing to the sink set by the program.\n";
+                }
+                return static_cast<int>(ReturnCode::Ok);
+            }
+            if (input[1] == "on" && input.size() <= 3) {
+                std::size_t events = 1 << 14;
+                if (input.size() == 3) {
+                    char *end = nullptr;
+                    events = std::strtoull(input[2].c_str(), &end, 10);
+                    if (*end != '\0' || events == 0) { return usage(); }
+                }
+                // Starting over only when the size changes keeps the events traced so far.
+                if (!impl.traceRing_ || (input.size() == 3 && impl.traceRing_->capacity() != events)) {
+                    impl.traceRing_ = std::make_shared<TraceRing>(events);
+                }
+                impl.setTracer(impl.traceRing_);
+            } else if (input[1] == "off" && input.size() == 2) {
+                impl.setTracer(nullptr);
+            } else if (input[1] == "chrome" && input.size() == 3) {
+                auto file = std::make_shared<ChromeTraceSink>();
+                if (!file->open(input[2])) {
+                    impl.output() << "Could not create the file '" << input[2] << "'.\n";
+                    return static_cast<int>(ReturnCode::Error);
+                }
+                impl.setTracer(file);
+                impl.traceFile_ = std::move(file);
+            } else if (input[1] == "dump" && input.size() <= 3) {
+                if (!impl.traceRing_) {
+                    impl.output() << "Nothing was traced to the ring, start with 'trace on'.\n";
+                    return static_cast<int>(ReturnCode::Error);
+                }
+                if (input.size() == 3) {
+                    ChromeTraceSink file;
+                    if (!file.open(input[2])) {
+                        impl.output() << "Could not create the file '" << input[2] << "'.\n";
+                        return static_cast<int>(ReturnCode::Error);
+                    }
+                    impl.traceRing_->dump(file);
+                    return static_cast<int>(ReturnCode::Ok);
+                }
+                auto &records = impl.records();
+                if (!records.isEnabled()) { impl.output() << "Thread\tStart\tDuration (microseconds)\tSpan\tDetail\n"; }
+                TraceTable table(impl.output(), records);
+                impl.traceRing_->dump(table);
+            } else {
+                return usage();
+            }
+            return static_cast<int>(ReturnCode::Ok);
+        }, std::vector<std::string>{"on", "off", "chrome", "dump"},
+           Impl::described("Traces where the time goes, to a ring shown by 'trace dump' or a Chrome trace file.\n"
+                           "Usage: trace [on [events]|off|chrome <file>|dump [file]]"));
         // Quit and Exit simply terminate the console.
-        pimpl_->commands_["quit"] = {[this](const Arguments &) {
+        pimpl_->insertCommand("quit", [this](const Arguments &) {
             return ReturnCode::Quit;
-        }, std::vector<std::string>()};
+        }, std::vector<std::string>(), Impl::described("Ends the session."));
 
-        pimpl_->commands_["exit"] = {[this](const Arguments &) {
+        pimpl_->insertCommand("exit", [this](const Arguments &) {
             return ReturnCode::Quit;
-        }, std::vector<std::string>()};
+        }, std::vector<std::string>(), Impl::described("Ends the session."));
     }
 
-    Console::~Console() = default;
+    Console::~Console() {
+        if (currentConsole == this) {
+            // Take the history back from readline, so that it is freed with the rest.
+            saveState();
+            history_set_history_state(&emptyHistory);
+            currentConsole = nullptr;
+        }
+    }
 
-    void Console::registerCommand(const std::string &s, CommandFunction f) {
-        pimpl_->commands_[s] = f;
+    void Console::registerCommand(const std::string &s, CommandFunction f, CommandOptions options) {
+        pimpl_->insertCommand(s, std::move(f.first), std::move(f.second), std::move(options));
+    }
+
+    void Console::registerCommand(const std::string &s, CommandViewFunction f, CommandOptions options) {
+        pimpl_->insertCommand(s, std::move(f.first), std::move(f.second), std::move(options));
+    }
+
+    void Console::registerCommand(const std::string &s, CommandPmrFunction f, CommandOptions options) {
+        pimpl_->insertCommand(s, std::move(f.first), std::move(f.second), std::move(options));
+    }
+
+    void Console::registerCommands(std::vector<Registration> commands) {
+        std::vector<CommandRegistry::Pointer> built;
+        built.reserve(commands.size());
+        for (auto &command : commands) {
+            // Every alternative is a pair of a function and the arguments.
+            std::visit([&](auto &function) {
+                built.push_back(pimpl_->makeCommand(std::move(command.name), std::move(function.first),
+                                                    std::move(function.second), std::move(command.options)));
+            }, command.function);
+        }
+        pimpl_->commands_.insert(std::move(built));
+    }
+
+    bool Console::unregisterCommand(const std::string &s) {
+        return pimpl_->commands_.erase(s);
+    }
+
+    std::size_t Console::unregisterNamespace(const std::string &prefix) {
+        if (prefix.empty()) { return 0; }
+        return pimpl_->commands_.erasePrefix(prefix.back() == '.' ? prefix : prefix + '.');
     }
 
     std::vector<std::string> Console::getRegisteredCommands() const {
-        std::vector<std::string> allCommands;
-        for (auto &pair : pimpl_->commands_) { allCommands.push_back(pair.first); }
+        return *pimpl_->names();
+    }
 
-        return allCommands;
+    Console::CommandNames Console::getCommandNames() const {
+        return pimpl_->names();
     }
 
     void Console::saveState() {
-        free(pimpl_->history_);
-        pimpl_->history_ = history_get_history_state();
+        // Only the list header is allocated, whatever the length of the history.
+        HISTORY_STATE *state = history_get_history_state();
+        pimpl_->history_ = *state;
+        free(state);
     }
 
     void Console::reserveConsole() {
-        if (currentConsole == this) { return; }
+        if (currentConsole != this) {
+            // Save state of other Console
+            if (currentConsole) {
+                currentConsole->saveState();
+            }
+
+            // Else we swap state
+            history_set_history_state(&pimpl_->history_);
+            pimpl_->applyHistoryLimit();
+            pimpl_->bindHistorySearch();
 
-        // Save state of other Console
-        if (currentConsole) {
-            currentConsole->saveState();
+            // Tell others we are using the console
+            currentConsole = this;
         }
 
-        // Else we swap state
-        if (!pimpl_->history_) {
-            history_set_history_state(emptyHistory);
-        } else {
-            history_set_history_state(pimpl_->history_);
+        // Read on first use, so that setting up a Console stays cheap.
+        if (pimpl_->historyPending_) { pimpl_->loadHistory(); }
+    }
+
+    void Console::setHistoryLimit(std::size_t entries) {
+        pimpl_->historyLimit_ = entries;
+        pimpl_->historyFile_.setLimit(entries);
+        pimpl_->historyIndex_.setLimit(entries);
+        if (currentConsole == this) { pimpl_->applyHistoryLimit(); }
+    }
+
+    void Console::setHistoryIndex(bool enabled) {
+        auto &impl = *pimpl_;
+        if (enabled == impl.indexHistory_) { return; }
+        impl.historyIndex_.clear();
+        if (enabled) {
+            // Index what is already there, wherever it currently lives.
+            bool current = currentConsole == this;
+            auto **entries = current ? history_list() : impl.history_.entries;
+            int length = current ? history_length : impl.history_.length;
+            impl.historyIndex_.setLimit(impl.historyLimit_);
+            for (int i = 0; entries && i < length; ++i) { impl.historyIndex_.add(entries[i]->line); }
+        }
+        impl.indexHistory_ = enabled;
+        if (currentConsole == this) { impl.bindHistorySearch(); }
+    }
+
+    std::size_t Console::getHistoryLimit() const {
+        return pimpl_->historyLimit_;
+    }
+
+    bool Console::setHistoryFile(const std::string &filename) {
+        auto &impl = *pimpl_;
+        impl.historyPending_ = false;
+        if (filename.empty()) {
+            impl.historyFile_.close();
+            return true;
         }
+        if (!impl.historyFile_.open(filename)) { return false; }
+        impl.historyPending_ = true;
+        return true;
+    }
+
+    void Console::setOutputSink(std::shared_ptr<OutputSink> sink) {
+        pimpl_->output_->flush();
+        pimpl_->output_ = std::move(sink);
+    }
+
+    OutputSink &Console::getOutputSink() const {
+        return pimpl_->output();
+    }
+
+    void Console::setQuiet(bool quiet) {
+        pimpl_->quiet_ = quiet;
+    }
+
+    bool Console::isQuiet() const {
+        return pimpl_->quiet_;
+    }
+
+    void Console::setChaining(bool enabled) {
+        pimpl_->chaining_ = enabled;
+    }
+
+    bool Console::isChaining() const {
+        return pimpl_->chaining_;
+    }
 
-        // Tell others we are using the console
-        currentConsole = this;
+    void Console::setCompletionMode(CompletionMode mode) {
+        pimpl_->completionMode_ = mode;
+        pimpl_->commands_.setSubstringIndex(mode == CompletionMode::Substring);
+    }
+
+    Console::CompletionMode Console::getCompletionMode() const {
+        return pimpl_->completionMode_;
     }
 
     void Console::setGreeting(const std::string &greeting) {
         pimpl_->greeting_ = greeting;
+        if (pimpl_->inputInstalled_ && currentConsole == this) { rl_set_prompt(pimpl_->greeting_.c_str()); }
     }
 
     std::string Console::getGreeting() const {
         return pimpl_->greeting_;
     }
 
-    int Console::executeCommand(const std::string &command) {
-        // Convert input to vector
-        std::vector<std::string> inputs;
-        {
-            std::istringstream iss(command);
-            std::copy(std::istream_iterator<std::string>(iss),
-                      std::istream_iterator<std::string>(),
-                      std::back_inserter(inputs));
-        }
+    int Console::executeCommand(std::string_view command) {
+        TraceScope trace(pimpl_->tracer(), "execute", command);
+        if (pimpl_->chaining_ && Impl::isChained(command)) { return pimpl_->executeChain(*this, command); }
+        return pimpl_->executeLine(*this, command);
+    }
 
-        if (inputs.size() == 0) { return ReturnCode::Ok; }
+    int Console::executeCommand(std::string_view command, OutputSink &output) {
+        struct Restore {
+            OutputSink *previous;
+            ~Restore() { outputOverride = previous; }
+        } restore{outputOverride};
+        outputOverride = &output;
+        return executeCommand(command);
+    }
 
-        Impl::RegisteredCommands::iterator it;
-        if ((it = pimpl_->commands_.find(inputs[0])) != end(pimpl_->commands_)) {
-            return static_cast<int>((it->second.first)(inputs));
+    int Console::executeFile(const std::string &filename, ScriptOptions options) {
+        TraceScope trace(pimpl_->tracer(), "executeFile", filename);
+        bool preprocess = pimpl_->preprocessScripts_;
+        std::string error;
+        auto script = pimpl_->cacheScripts_ ? pimpl_->scripts_.get(filename, pimpl_->commands_, preprocess, error)
+                                            : nullptr;
+        bool cached = script != nullptr;
+        // Scripts which cannot be cached, like stdin, are still preprocessed.
+        if (!script && preprocess && error.empty()) {
+            script = ScriptCache::compile(filename, pimpl_->commands_, true, error);
+        }
+        if (!error.empty()) {
+            pimpl_->output() << error << '\n';
+            return ReturnCode::Error;
+        }
+        LineScanner input;
+        if (!script && !input.open(filename, pimpl_->mappedScripts_)) {
+            pimpl_->output() << "Could not find the specified file to execute.\n";
+            return ReturnCode::Error;
         }
 
-        std::cout << "Command '" << inputs[0] << "' not found.\n";
-        return ReturnCode::Error;
-    }
+        ScriptStatistics statistics;
+        statistics.mapped = input.isMapped();
+        auto start = std::chrono::steady_clock::now();
+        struct Report {
+            ScriptStatistics &statistics, &last;
+            std::chrono::steady_clock::time_point start;
+            std::mutex &mutex;
+            ~Report() {
+                statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::lock_guard<std::mutex> lock(mutex);
+                last = statistics;
+            }
+        } report{statistics, pimpl_->scriptStatistics_, start, pimpl_->scriptStatisticsMutex_};
+        struct Structured {
+            bool previous;
+            ~Structured() { structuredScript = previous; }
+        } structured{structuredScript};
+        structuredScript = structuredScript || options.json;
 
-    int Console::executeFile(const std::string &filename) {
-        std::ifstream input(filename);
-        if (!input) {
-            std::cout << "Could not find the specified file to execute.\n";
-            return ReturnCode::Error;
+        if (script) {
+            statistics.cached = cached;
+            return pimpl_->executeCompiled(*this, *script, options.threads, statistics);
         }
-        std::string command;
-        int counter = 0, result;
+        if (options.threads > 1) { return pimpl_->executeParallel(*this, input, options.threads, statistics); }
+
+        std::string_view command;
+        std::size_t counter = 0;
+        int result;
 
-        while (std::getline(input, command)) {
-            if (command[0] == '#') { continue; } // Ignore comments
+        while (input.next(command)) {
+            ++statistics.lines;
+            if (!command.empty() && command[0] == '#') { continue; } // Ignore comments
             // Report what the Console is executing.
-            std::cout << "[" << counter << "] " << command << '\n';
-            if ((result = executeCommand(command))) { return result; }
-            ++counter;
-            std::cout << '\n';
+            pimpl_->reportCommand(counter, command);
+            ++statistics.commands;
+            result = executeCommand(command);
+            pimpl_->reportResult(counter++, command, result);
+            if (result) { return result; }
         }
 
         // If we arrived successfully at the end, all is ok
         return ReturnCode::Ok;
     }
 
+    double Console::CommandStatistics::quantile(double q) const {
+        auto rank = q * calls;
+        for (auto &bucket : buckets) {
+            if (bucket.second >= rank) { return std::min(bucket.first, maxSeconds); }
+        }
+        return maxSeconds;
+    }
+
+    void Console::setSessionRecorder(std::shared_ptr<SessionRecorder> recorder) {
+        pimpl_->recorder_ = std::move(recorder);
+    }
+
+    void Console::setTraceSink(std::shared_ptr<TraceSink> sink) {
+        std::lock_guard<std::mutex> lock(pimpl_->traceMutex_);
+        pimpl_->setTracer(std::move(sink));
+    }
+
+    std::shared_ptr<TraceSink> Console::getTraceSink() const {
+        std::lock_guard<std::mutex> lock(pimpl_->traceMutex_);
+        auto *current = pimpl_->tracer_.load();
+        for (auto &sink : pimpl_->traceSinks_) {
+            if (sink.get() == current) { return sink; }
+        }
+        return nullptr;
+    }
+
+    void Console::setCommandStatistics(bool enabled) {
+        pimpl_->recordStatistics_ = enabled;
+    }
+
+    std::vector<Console::CommandStatistics> Console::getCommandStatistics() const {
+        auto names = pimpl_->commands_.names();
+        std::vector<CommandStatistics> statistics;
+        statistics.reserve(names.size());
+        LatencyHistogram::Buckets buckets;
+        for (auto &name : names) {
+            auto command = pimpl_->commands_.find(name);
+            // Replaced or removed meanwhile.
+            if (!command) { continue; }
+            statistics.emplace_back();
+            auto &entry = statistics.back();
+            entry.name = std::move(name);
+            command->latency.snapshot(buckets);
+            entry.seconds = command->latency.total() * 1e-9;
+            entry.maxSeconds = command->latency.max() * 1e-9;
+            std::uint64_t count = 0;
+            entry.buckets.reserve(buckets.size());
+            for (auto &bucket : buckets) {
+                count += bucket.second;
+                entry.buckets.emplace_back(bucket.first * 1e-9, count);
+            }
+            // The errors are counted after the latency, so make them agree.
+            entry.calls = count;
+            entry.errors = std::min(command->errors.load(std::memory_order_relaxed), count);
+        }
+        return statistics;
+    }
+
+    void Console::resetCommandStatistics() {
+        for (auto &name : pimpl_->commands_.names()) {
+            if (auto command = pimpl_->commands_.find(name)) {
+                command->latency.reset();
+                command->errors = 0;
+            }
+        }
+    }
+
+    Console::ScriptStatistics Console::getLastScriptStatistics() const {
+        std::lock_guard<std::mutex> lock(pimpl_->scriptStatisticsMutex_);
+        return pimpl_->scriptStatistics_;
+    }
+
+    void Console::setMappedScripts(bool mapped) {
+        pimpl_->mappedScripts_ = mapped;
+    }
+
+    void Console::registerAlias(const std::string &alias, const std::string &text) {
+        std::shared_ptr<Alias> entry(new Alias{alias, text, {}});
+        Tokenizer tokenizer;
+        entry->tokens = tokenizer.tokenize(entry->text);
+        if (entry->tokens.empty()) { return; }
+        pimpl_->commands_.insertAlias(std::move(entry));
+    }
+
+    bool Console::unregisterAlias(const std::string &alias) {
+        return pimpl_->commands_.eraseAlias(alias);
+    }
+
+    void Console::setAbbreviations(bool enabled) {
+        pimpl_->abbreviations_ = enabled;
+    }
+
+    void Console::setStructuredOutput(bool enabled) {
+        pimpl_->structured_ = enabled;
+    }
+
+    bool Console::isStructuredOutput() const {
+        return pimpl_->structured();
+    }
+
+    RecordWriter &Console::getRecordWriter() {
+        return pimpl_->records();
+    }
+
+    void Console::setScriptPreprocessing(bool enabled) {
+        pimpl_->preprocessScripts_ = enabled;
+    }
+
+    void Console::setScriptCaching(bool enabled) {
+        pimpl_->cacheScripts_ = enabled;
+        if (!enabled) { pimpl_->scripts_.clear(); }
+    }
+
+    void Console::setWorkerThreads(std::size_t threads) {
+        std::unique_ptr<ThreadPool> pool;
+        {
+            std::lock_guard<std::mutex> lock(pimpl_->jobsMutex_);
+            pimpl_->workerThreads_ = threads;
+            // The next job starts a new pool of the new size.
+            pool = std::move(pimpl_->pool_);
+        }
+    }
+
+    int Console::getLastJobId() const {
+        return pimpl_->lastJobId_;
+    }
+
+    void Console::reportFinishedJobs() {
+        auto &impl = *pimpl_;
+        std::deque<std::shared_ptr<Job>> finished;
+        {
+            std::lock_guard<std::mutex> lock(impl.jobsMutex_);
+            finished.swap(impl.finishedJobs_);
+            for (auto &job : finished) { impl.jobs_.erase(job->id); }
+        }
+        if (finished.empty()) { return; }
+
+        // Print the reports where the prompt was, then draw it again below.
+        bool atPrompt = promptShown && currentConsole == this;
+        if (atPrompt) { rl_clear_visible_line(); }
+        struct Redisplay {
+            bool atPrompt;
+            OutputSink &output;
+            ~Redisplay() {
+                if (!atPrompt) { return; }
+                output.flush();
+                rl_on_new_line();
+                rl_redisplay();
+            }
+        } redisplay{atPrompt, *impl.output_};
+
+        auto &output = impl.output();
+        for (auto &job : finished) {
+            output << "[" << job->id << "] ";
+            if (job->state == Job::Cancelled) {
+                output << "Cancelled";
+            } else {
+                output << "Done (" << job->result << ")";
+            }
+            output << "\t" << job->command << '\n';
+            auto &text = job->output.str();
+            output << text;
+            if (!text.empty() && text.back() != '\n') { output << '\n'; }
+        }
+    }
+
+    bool Console::isCancelled() {
+        return currentJob && currentJob->cancelled;
+    }
+
+    int Console::jobEventHook() {
+        if (currentConsole) { currentConsole->reportFinishedJobs(); }
+        return 0;
+    }
+
+    bool Console::isInteractive() const {
+        int fd = getInputFd();
+        if (batchInput.fd != fd) {
+            batchInput.fd = fd;
+            batchInput.interactive = isatty(fd);
+            if (!batchInput.interactive) { batchInput.scanner.open(fd); }
+        }
+        return batchInput.interactive;
+    }
+
     int Console::readLine() {
         reserveConsole();
+        auto *sink = pimpl_->tracer();
+        TraceScope trace(sink, "readLine");
 
+        if (!isInteractive()) {
+            // Neither prompt nor history, and the output is only flushed at
+            // the end, so that large inputs are not slowed down per line.
+            reportFinishedJobs();
+            std::string_view line;
+            TraceScope input(sink, "input");
+            bool read = batchInput.scanner.next(line);
+            input.end();
+            if (!read) {
+                TraceScope flushing(sink, "flush");
+                pimpl_->output_->flush();
+                return ReturnCode::Quit;
+            }
+            return pimpl_->executeInput(*this, line);
+        }
+
+        reportFinishedJobs();
+        rl_event_hook = pimpl_->hasAsyncCommands_ ? &Console::jobEventHook : nullptr;
+        // Whatever is still buffered has to appear before the prompt.
+        TraceScope flushing(sink, "flush");
+        pimpl_->output_->flush();
+        flushing.end();
+        promptShown = true;
+        TraceScope input(sink, "input");
         char *buffer = readline(pimpl_->greeting_.c_str());
+        input.end();
+        promptShown = false;
+        return acceptLine(buffer);
+    }
+
+    void Console::installInputHandler() {
+        reserveConsole();
+
+        reportFinishedJobs();
+        pimpl_->output_->flush();
+        pimpl_->inputInstalled_ = true;
+        pimpl_->lineDone_ = false;
+        rl_callback_handler_install(pimpl_->greeting_.c_str(), &Console::lineHandler);
+        promptShown = true;
+    }
+
+    void Console::removeInputHandler() {
+        if (!pimpl_->inputInstalled_) { return; }
+        pimpl_->inputInstalled_ = false;
+        promptShown = false;
+        if (currentConsole == this) { rl_callback_handler_remove(); }
+    }
+
+    int Console::getInputFd() const {
+        return fileno(rl_instream ? rl_instream : stdin);
+    }
+
+    bool Console::processInput(int &result) {
+        auto &impl = *pimpl_;
+        if (!impl.inputInstalled_) { return false; }
+        reserveConsole();
+
+        // Consume whatever is available, up to the end of the first line.
+        pollfd input{getInputFd(), POLLIN, 0};
+        do {
+            rl_callback_read_char();
+        } while (impl.inputInstalled_ && !impl.lineDone_ && poll(&input, 1, 0) > 0 && (input.revents & POLLIN));
+
+        reportFinishedJobs();
+        if (!impl.lineDone_) { return false; }
+        impl.lineDone_ = false;
+        result = impl.lineResult_;
+        return true;
+    }
+
+    void Console::lineHandler(char *buffer) {
+        if (!currentConsole) {
+            free(buffer);
+            return;
+        }
+        auto &console = *currentConsole;
+        auto &impl = *console.pimpl_;
+
+        promptShown = false;
         if (!buffer) {
-            std::cout << '\n'; // EOF doesn't put last endline so we put that so that it looks uniform.
+            // There is nothing left to read, so stop like readLine does.
+            rl_callback_handler_remove();
+            impl.inputInstalled_ = false;
+        }
+        impl.lineResult_ = console.acceptLine(buffer);
+        impl.lineDone_ = true;
+        if (!impl.inputInstalled_) { return; }
+
+        // readline shows the prompt again right after this returns.
+        console.reportFinishedJobs();
+        TraceScope flushing(impl.tracer(), "flush");
+        impl.output_->flush();
+        flushing.end();
+        promptShown = true;
+    }
+
+    int Console::acceptLine(char *buffer) {
+        if (!buffer) {
+            // EOF doesn't put last endline so we put that so that it looks uniform.
+            *pimpl_->output_ << '\n';
+            pimpl_->output_->flush();
             return ReturnCode::Quit;
         }
 
         // TODO: Maybe add commands to history only if succeeded?
         if (buffer[0] != '\0') {
             add_history(buffer);
+            if (pimpl_->indexHistory_) { pimpl_->historyIndex_.add(buffer); }
+            if (pimpl_->historyFile_.append(buffer)) { pimpl_->compactHistory(); }
         }
 
-        std::string line(buffer);
-        free(buffer);
+        struct Release {
+            char *buffer;
+            ~Release() { free(buffer); }
+        } release{buffer};
+
+        return pimpl_->executeInput(*this, buffer);
+    }
+
+    int Console::historySearch(int, int) {
+        if (!currentConsole) { return 0; }
+        auto &index = currentConsole->pimpl_->historyIndex_;
+        std::string original(rl_line_buffer);
+        int point = rl_point;
 
-        return executeCommand(line);
+        std::string text;
+        HistoryIndex::Matches matches;
+        // The shown match, searching again starts right before it.
+        std::string match;
+        std::uint64_t matchId = HistoryIndex::Newest;
+        bool failed = false;
+        auto find = [&](std::uint64_t before) {
+            index.search(text, 1, matches, before);
+            failed = matches.empty();
+            if (failed) { return; }
+            match = matches[0].line;
+            matchId = matches[0].id;
+        };
+
+        while (true) {
+            rl_message("(%sindexed-search)`%s': %s", failed ? "failed " : "", text.c_str(), match.c_str());
+            int c = rl_read_key();
+            if (c == CTRL('R')) {
+                // Older matches of the same text.
+                // On failure the last match found stays shown.
+                if (!text.empty() && !failed) { find(matchId); }
+            } else if (c == CTRL('G')) {
+                rl_replace_line(original.c_str(), 0);
+                rl_point = point;
+                break;
+            } else if (c == RUBOUT || c == CTRL('H')) {
+                if (!text.empty()) { text.pop_back(); }
+                match.clear();
+                matchId = HistoryIndex::Newest;
+                failed = false;
+                if (!text.empty()) { find(HistoryIndex::Newest); }
+            } else if (c >= ' ') {
+                text.push_back(static_cast<char>(c));
+                // The shown match may still contain the longer text.
+                find(matchId == HistoryIndex::Newest ? matchId : matchId + 1);
+            } else {
+                // Any other key takes the match, and does what it always does.
+                if (!match.empty()) {
+                    rl_replace_line(match.c_str(), 0);
+                    rl_point = rl_end;
+                }
+                rl_execute_next(c);
+                break;
+            }
+        }
+        rl_clear_message();
+        return 0;
     }
 
     char **Console::getCommandCompletions(const char *text, int start, int) {
         char **completionList = nullptr;
+        TraceScope trace(currentConsole ? currentConsole->pimpl_->tracer() : nullptr, "complete", text);
+
+        // Fuzzy matches come ranked, and must be shown that way.
+        rl_sort_completion_matches = !currentConsole ||
+                                     currentConsole->pimpl_->completionMode_ != CompletionMode::Fuzzy;
 
         if (start == 0) {
             completionList = rl_completion_matches(text, &Console::commandIterator);
@@ -197,78 +1846,65 @@ namespace CppReadline {
         return completionList;
     }
 
-    char *Console::argumentIterator(const char *text, int state) {
-        if (!currentConsole) {
-            return nullptr;
-        }
+    std::vector<std::string> Console::getCompletions(std::string_view line) const {
+        TraceScope trace(pimpl_->tracer(), "complete", line);
+        // The word being completed starts after the last separator.
+        std::size_t start = line.size();
+        while (start > 0 && !Tokenizer::isSeparator(line[start - 1])) { --start; }
+        std::string_view text = line.substr(start);
 
-        // split input
-        std::istringstream iss(rl_line_buffer);
-        std::vector<std::string> results(std::istream_iterator<std::string>{iss},
-                                         std::istream_iterator<std::string>());
-        std::string commandName = results.at(0);
-        std::string argName;
-        if (results.size() > 1) {
-            argName = results.at(1);
-        }
-
-        auto cmdIt = currentConsole->pimpl_->commands_.find(commandName);
-        if (cmdIt == currentConsole->pimpl_->commands_.end()) {
-            return nullptr;
-        }
-
-        auto &params = currentConsole->pimpl_->commands_[commandName].second;
-        if (params.empty()) {
-            rl_attempted_completion_over = 1;
-            return nullptr;
-        }
-
-        if (params.at(0) == Console::COMPLETE_FILE) {
-            return nullptr;
+        CommandRegistry::Names matches;
+        // Like readline, only a word at the very start is a command.
+        if (start == 0) {
+            pimpl_->completeCommand(text, matches);
+        } else {
+            pimpl_->completeArgument(line, text, matches);
         }
+        return matches;
+    }
 
-        rl_attempted_completion_over = 1;
-
-        static std::vector<std::string>::iterator it;
+    char *Console::argumentIterator(const char *text, int state) {
         if (!currentConsole) {
             return nullptr;
         }
+        auto &impl = *currentConsole->pimpl_;
 
         if (state == 0) {
-            it = params.begin();
-        }
-
-
-        while (it + 1 != params.end()) {
-            ++it;
-            if (std::strstr(rl_line_buffer, it->c_str()) != nullptr) {
-                continue;
-            }
-
-            if (it->find(argName) != std::string::npos) {
-                return strdup(it->c_str());
+            impl.completionsIndex_ = 0;
+            bool filenames = false;
+            // Otherwise let readline fall back to its filename completion.
+            if (impl.completeArgument(rl_line_buffer, text, impl.completions_, &filenames)) {
+                rl_attempted_completion_over = 1;
+                // Lets readline quote the paths and show only their last component.
+                rl_filename_completion_desired = filenames;
             }
         }
 
+        if (impl.completionsIndex_ < impl.completions_.size()) {
+            return strdup(impl.completions_[impl.completionsIndex_++].c_str());
+        }
         return nullptr;
     }
 
     char *Console::commandIterator(const char *text, int state) {
-        static Impl::RegisteredCommands::iterator it;
         if (!currentConsole) {
             return nullptr;
         }
-        auto &commands = currentConsole->pimpl_->commands_;
-
-        if (state == 0) { it = begin(commands); }
+        auto &impl = *currentConsole->pimpl_;
 
-        while (it != end(commands)) {
-            auto &command = it->first;
-            ++it;
-            if (command.find(text) != std::string::npos) {
-                return strdup(command.c_str());
+        if (state == 0) {
+            impl.completionsIndex_ = 0;
+            impl.completeCommand(text, impl.completions_);
+            // A namespace is completed further, so no space goes after it.
+            auto &matches = impl.completions_;
+            if (matches.size() == 1 && !matches[0].empty() && matches[0].back() == '.') {
+                rl_completion_append_character = '\0';
             }
         }
+
+        if (impl.completionsIndex_ < impl.completions_.size()) {
+            return strdup(impl.completions_[impl.completionsIndex_++].c_str());
+        }
         return nullptr;
     }
 }
@@ -1,14 +1,61 @@
 #ifndef CONSOLE_CONSOLE_HEADER_FILE
 #define CONSOLE_CONSOLE_HEADER_FILE
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
 #include <vector>
 #include <memory>
+#include <memory_resource>
+
+#include "ArgumentTraits.hpp"
+#include "OutputSink.hpp"
+#include "RecordWriter.hpp"
 
 namespace CppReadline {
+    class SessionRecorder;
+    class TraceSink;
+
+    /**
+     * @brief This struct holds the optional settings of a registered command.
+     */
+    struct CommandOptions {
+        // Async commands run on the worker threads of the Console, so
+        // executing them returns right away. See Console::setWorkerThreads.
+        bool async = false;
+        // Returns the candidates for completing arguments, instead of the
+        // fixed ones registered with the command. It is called on a
+        // background thread, and what it returns is used for completion
+        // until it is older than completionTtl.
+        std::function<std::vector<std::string>()> completion{};
+        std::chrono::milliseconds completionTtl = std::chrono::seconds(30);
+        // Shown by "help <command>". The first line also appears in the list
+        // of all commands shown by "help".
+        std::string description{};
+    };
+
+    /**
+     * @brief This struct holds the optional settings of a script execution.
+     */
+    struct ScriptOptions {
+        // With more than one thread, the commands of the script are assumed
+        // to be independent of each other and run in parallel.
+        std::size_t threads = 1;
+        // Turns on structured output for the commands of the script, and
+        // reports each with a record holding its line, text and result,
+        // instead of echoing it.
+        bool json = false;
+    };
+
     class Console {
     public:
+        // As first argument, the arguments of a command are completed as
+        // filenames. Any further arguments are the extensions of the files
+        // offered, e.g. {COMPLETE_FILE, ".txt"}; directories are always offered.
         inline static const std::string COMPLETE_FILE = "CONSOLE::COMPLETE::FILE";
     public:
         /**
@@ -23,19 +70,109 @@ namespace CppReadline {
         using Arguments = std::vector<std::string>;
         using CommandFunction = std::pair<std::function<int(const Arguments &)>, std::vector<std::string>>;
 
+        /**
+         * @brief This is the allocation free variant of CommandFunction.
+         *
+         * The vector holds views into the executed line instead of copies of
+         * its elements. The views are only valid while the function runs, so
+         * they have to be copied if the function needs to keep them.
+         */
+        using ArgumentViews = std::vector<std::string_view>;
+        using CommandViewFunction = std::pair<std::function<int(const ArgumentViews &)>, std::vector<std::string>>;
+
+        /**
+         * @brief This is the variant of CommandFunction with arguments allocated from an arena.
+         *
+         * Each nesting level of executing commands on a thread has its own
+         * arena, which is reset after the command returns, so the arguments
+         * only live while the function runs. The function can allocate its
+         * own transient data from the arena through the allocator of the
+         * vector. Once the arena has grown to fit, executing commands does
+         * not touch the global allocator anymore.
+         */
+        using PmrArguments = std::pmr::vector<std::pmr::string>;
+        using CommandPmrFunction = std::pair<std::function<int(const PmrArguments &)>, std::vector<std::string>>;
+
+        /**
+         * @brief This struct holds a command to be registered with registerCommands.
+         */
+        struct Registration {
+            std::string name{};
+            std::variant<CommandFunction, CommandViewFunction, CommandPmrFunction> function{};
+            CommandOptions options{};
+        };
+
         enum ReturnCode {
             Quit = -1,
             Ok = 0,
             Error = 1 // Or greater!
         };
 
+        /**
+         * @brief This enum selects how typed text is matched against command names on completion.
+         *
+         * Prefix matching uses a sorted index of the names, so its cost only
+         * depends on the length of the text and the number of matches.
+         * Substring matching additionally maintains a trigram index. Fuzzy
+         * matching accepts any name containing the typed characters in
+         * order, and offers the best ranked first instead of alphabetically.
+         */
+        enum CompletionMode {
+            Prefix,
+            Substring,
+            Fuzzy
+        };
+
+        /**
+         * @brief This struct reports how the last script executed by executeFile went.
+         */
+        struct ScriptStatistics {
+            std::size_t lines = 0;    // Lines read, including comments.
+            std::size_t commands = 0; // Commands executed.
+            double seconds = 0.0;     // Wall clock time spent in the script.
+            bool mapped = false;      // Whether the script was memory mapped.
+            bool cached = false;      // Whether the script came from the script cache.
+
+            double linesPerSecond() const { return seconds > 0.0 ? lines / seconds : 0.0; }
+        };
+
+        /**
+         * @brief This struct reports how often a command ran, and how long it took.
+         *
+         * The buckets hold pairs of an upper bound in seconds and the number
+         * of calls which took at most that long, in increasing order. Only
+         * the bounds at which the count grows are listed, and the last count
+         * equals calls, so they map directly onto a Prometheus histogram.
+         */
+        struct CommandStatistics {
+            std::string name;
+            std::uint64_t calls = 0;  // Executions which returned.
+            std::uint64_t errors = 0; // Executions which returned an error code.
+            double seconds = 0.0;     // Time spent in all executions.
+            double maxSeconds = 0.0;  // Longest execution.
+            std::vector<std::pair<double, std::uint64_t>> buckets;
+
+            CommandStatistics() : name(), buckets() {}
+
+            double meanSeconds() const { return calls ? seconds / calls : 0.0; }
+
+            /**
+             * @brief This function returns the upper bound of the bucket holding the given quantile.
+             *
+             * @param q The quantile, between 0 and 1.
+             */
+            double quantile(double q) const;
+        };
+
         /**
          * @brief Basic constructor.
          *
          * The Console comes with two predefined commands: "quit" and
          * "exit", which both terminate the console, "help" which prints a
          * list of all registered commands, and "run" which executes script
-         * files.
+         * files. "jobs", "wait" and "cancel" manage async commands,
+         * "history grep" searches the history and "stats" prints the
+         * command statistics.
          *
          * These commands can be overridden or unregistered - but remember
          * to leave at least one to quit ;).
@@ -58,16 +195,146 @@ namespace CppReadline {
          *
          * @param s The name of the command as inserted by the user.
          * @param f The function that will be called once the user writes the command.
+         * @param options The settings of the command.
          */
-        void registerCommand(const std::string &s, CommandFunction f);
+        void registerCommand(const std::string &s, CommandFunction f, CommandOptions options = CommandOptions());
+
+        /**
+         * @brief This function registers a new command receiving views of its arguments.
+         *
+         * Commands registered this way can be dispatched without any memory
+         * allocation once the Console has warmed up.
+         *
+         * @param s The name of the command as inserted by the user.
+         * @param f The function that will be called once the user writes the command.
+         * @param options The settings of the command.
+         */
+        void registerCommand(const std::string &s, CommandViewFunction f, CommandOptions options = CommandOptions());
+
+        /**
+         * @brief This function registers a new command receiving its arguments in an arena.
+         *
+         * @param s The name of the command as inserted by the user.
+         * @param f The function that will be called once the user writes the command.
+         * @param options The settings of the command.
+         */
+        void registerCommand(const std::string &s, CommandPmrFunction f, CommandOptions options = CommandOptions());
+
+        /**
+         * @brief This function registers a new command whose arguments are parsed for it.
+         *
+         * The argument types are those of the parameters of f: integers,
+         * floating point numbers, bool, char, std::string, std::string_view,
+         * or std::optional of those for trailing arguments which may be left
+         * out. They are parsed with std::from_chars before f is called. If
+         * their number does not fit or one of them does not parse, a usage
+         * line generated from the types is printed instead, and Error is
+         * returned. f may return void, which counts as Ok.
+         *
+         * @param s The name of the command as inserted by the user.
+         * @param f The function that will be called with the parsed arguments.
+         * @param options The settings of the command.
+         */
+        template <typename F, typename = std::enable_if_t<HandlerTraits<F>::supported>>
+        void registerCommand(const std::string &s, F f, CommandOptions options = CommandOptions());
+
+        /**
+         * @brief This function registers many commands at once.
+         *
+         * The commands are moved into the Console, and the completion
+         * indexes are updated once for the whole batch, so this is much
+         * cheaper than registering the commands one by one. Commands
+         * executing on other threads see either none or all of them.
+         *
+         * @param commands The commands to register, replacing any with the same names.
+         */
+        void registerCommands(std::vector<Registration> commands);
+
+        /**
+         * @brief This function unregisters a command.
+         *
+         * A command being executed meanwhile still completes.
+         *
+         * @param s The name of the command.
+         *
+         * @return Whether the command was registered.
+         */
+        bool unregisterCommand(const std::string &s);
+
+        /**
+         * @brief This function unregisters all commands of a namespace.
+         *
+         * Names can be structured into namespaces by dots, like
+         * "db.table.list": unregistering "db" or "db.table" removes this
+         * command. Completing the prefix of such names only offers the next
+         * level, e.g. "db.table." rather than all the commands below it.
+         *
+         * @param prefix The namespace, with or without the trailing dot.
+         *
+         * @return The number of commands unregistered.
+         */
+        std::size_t unregisterNamespace(const std::string &prefix);
+
+        /**
+         * @brief This function registers an alias for a command line.
+         *
+         * A line starting with the alias executes text instead, followed by
+         * the rest of the line: with registerAlias("j4", "run -j 4") the line
+         * "j4 script" executes "run -j 4 script". Lines are only looked up as
+         * aliases if their first word is no command, and the text must start
+         * with a command, not another alias.
+         *
+         * @param alias The name of the alias, replacing any alias with the same name.
+         * @param text The command line the alias stands for, it is ignored if empty.
+         */
+        void registerAlias(const std::string &alias, const std::string &text);
+
+        /**
+         * @brief This function removes an alias.
+         *
+         * @return Whether the alias was registered.
+         */
+        bool unregisterAlias(const std::string &alias);
+
+        /**
+         * @brief Sets whether commands can be abbreviated.
+         *
+         * A first word which is neither a command nor an alias then executes
+         * the only command starting with it, e.g. "st" runs "stats" unless
+         * another command starts with "st". Finding the command takes time
+         * proportional to the length of the word, however many commands are
+         * registered. Ambiguous abbreviations fail, listing the candidates.
+         *
+         * Registering a command can make an abbreviation ambiguous, so scripts
+         * meant to keep working should spell out the commands.
+         *
+         * @param enabled Whether to resolve abbreviations.
+         */
+        void setAbbreviations(bool enabled);
 
         /**
          * @brief This function returns a list with the currently available commands.
          *
-         * @return A vector containing all registered commands names.
+         * This copies all the names, getCommandNames does not.
+         *
+         * @return A vector containing all registered commands names, in sorted order.
          */
         std::vector<std::string> getRegisteredCommands() const;
 
+        using CommandNames = std::shared_ptr<const std::vector<std::string>>;
+
+        /**
+         * @brief This function returns the names of the registered commands, in sorted order.
+         *
+         * The list is built once and shared by all callers until commands
+         * are registered or unregistered, so calling this repeatedly costs
+         * neither allocations nor copies. The list never changes; a caller
+         * holding it keeps seeing the commands as they were.
+         *
+         * @return The names of all registered commands.
+         */
+        CommandNames getCommandNames() const;
+
         /**
          * @brief Sets the prompt for this Console.
          *
@@ -82,14 +349,190 @@ namespace CppReadline {
          */
         std::string getGreeting() const;
 
+        /**
+         * @brief Sets where the Console writes its own output.
+         *
+         * By default everything is written straight to std::cout. The sink
+         * is flushed before each prompt shown by readLine. Unlike the other
+         * settings, the sink is not guarded, so it must not be replaced while
+         * commands are executing on other threads.
+         *
+         * @param sink The new output sink.
+         */
+        void setOutputSink(std::shared_ptr<OutputSink> sink);
+
+        /**
+         * @brief Gets the sink the Console writes its own output to.
+         *
+         * Commands can write through it as well, to keep their output ordered
+         * with the Console's one.
+         *
+         * @return The currently set output sink.
+         */
+        OutputSink &getOutputSink() const;
+
+        /**
+         * @brief Sets whether executeFile echoes the commands it executes.
+         *
+         * @param quiet Whether to suppress the echo.
+         */
+        void setQuiet(bool quiet);
+
+        /**
+         * @brief Gets whether executeFile echoes the commands it executes.
+         *
+         * @return Whether the echo is suppressed.
+         */
+        bool isQuiet() const;
+
+        /**
+         * @brief Sets whether executed lines may chain several commands.
+         *
+         * With chaining, "a; b" executes a and then b, "a && b" executes b
+         * only if a returned Ok, and "a | b" executes b with the words a
+         * wrote appended to its arguments. Pipes bind tighter than the
+         * others, and a failing stage ends its pipeline. The result is that
+         * of the last command executed; empty commands are skipped, and a
+         * line with '&&' missing a command on either side executes nothing.
+         * Async commands run inline within a pipeline, since the next stage
+         * needs their output. Chaining is off by default, since ';', '&&'
+         * and '|' then can no longer appear within arguments.
+         *
+         * @param enabled Whether to split lines into chained commands.
+         */
+        void setChaining(bool enabled);
+
+        /**
+         * @brief Gets whether executed lines may chain several commands.
+         *
+         * @return Whether chaining is enabled.
+         */
+        bool isChaining() const;
+
+        /**
+         * @brief Sets how command names are completed.
+         *
+         * @param mode The new completion mode.
+         */
+        void setCompletionMode(CompletionMode mode);
+
+        /**
+         * @brief Gets how command names are completed.
+         *
+         * @return The currently set completion mode.
+         */
+        CompletionMode getCompletionMode() const;
+
+        /**
+         * @brief Sets how many entries the history of this Console keeps.
+         *
+         * Once the limit is reached, the oldest entries are dropped as new
+         * ones are added.
+         *
+         * @param entries The maximum number of entries, 0 for no limit.
+         */
+        void setHistoryLimit(std::size_t entries);
+
+        /**
+         * @brief Sets whether the history of this Console is indexed for searching.
+         *
+         * The index keeps a copy of the history, and finds the entries
+         * containing a text by only looking at those sharing its rarest
+         * trigram. While enabled, Ctrl-R is bound to an incremental search
+         * backed by the index, and the "history grep" command searches it.
+         *
+         * @param enabled Whether to index the history.
+         */
+        void setHistoryIndex(bool enabled);
+
+        /**
+         * @brief Gets how many entries the history of this Console keeps.
+         *
+         * @return The maximum number of entries, 0 for no limit.
+         */
+        std::size_t getHistoryLimit() const;
+
+        /**
+         * @brief Sets the file the history of this Console is persisted to.
+         *
+         * Each line entered is appended to the file right away. The file is
+         * read when the Console next uses readline, and with a history limit
+         * only its last entries are read, so large files load instantly. A
+         * limited file is compacted now and then to stay in proportion.
+         *
+         * @param filename The pathname of the file, empty to stop persisting.
+         *
+         * @return Whether the file could be opened.
+         */
+        bool setHistoryFile(const std::string &filename);
+
         /**
          * @brief This function executes an arbitrary string as if it was inserted via stdin.
          *
+         * Async commands are queued as a new job and Ok is returned right
+         * away, see getLastJobId. Async commands executed by a job run
+         * directly within that job.
+         *
+         * @param command The command that needs to be executed.
+         *
+         * @return The result of the operation.
+         */
+        int executeCommand(std::string_view command);
+
+        /**
+         * @brief This function executes a command, writing the Console's output to the given sink.
+         *
+         * For the duration of the call, on this thread only, everything the
+         * command and the Console write through getOutputSink goes to output.
+         * This is how a single Console serves several sessions at once.
+         * Async commands only write their job notice there; the job itself
+         * outlives the call, so its output is reported to the Console's sink.
+         *
          * @param command The command that needs to be executed.
+         * @param output Where the output of the command goes.
          *
          * @return The result of the operation.
          */
-        int executeCommand(const std::string &command);
+        int executeCommand(std::string_view command, OutputSink &output);
+
+        /**
+         * @brief Sets the number of threads running async commands.
+         *
+         * The threads are started when the first async command is executed.
+         * Changing the number afterwards waits for the running and queued
+         * jobs first, so it must not be called from an async command: the
+         * old pool would wait for the worker calling it, which deadlocks.
+         *
+         * @param threads The number of worker threads.
+         */
+        void setWorkerThreads(std::size_t threads);
+
+        /**
+         * @brief This function returns the id of the last job started by this Console.
+         *
+         * @return The job id, or 0 if no job has been started yet.
+         */
+        int getLastJobId() const;
+
+        /**
+         * @brief This function reports the jobs which finished since the last call.
+         *
+         * For each job its result and everything it wrote to the output sink
+         * are written to the Console's output sink. readLine does this before
+         * each prompt, and while waiting for input without disturbing the
+         * line being typed.
+         */
+        void reportFinishedJobs();
+
+        /**
+         * @brief This function returns whether the job running on this thread has been cancelled.
+         *
+         * Long running async commands should check it regularly, and return
+         * early once it turns true.
+         *
+         * @return Whether the current job was cancelled, false outside of jobs.
+         */
+        static bool isCancelled();
 
         /**
          * @brief This function calls an external script and executes all commands inside.
@@ -97,19 +540,250 @@ namespace CppReadline {
          * This function stops execution as soon as any single command returns something
          * different from 0, be it a quit code or an error code.
          *
+         * Regular files are memory mapped and their lines are executed in place,
+         * anything else (e.g. "-" for stdin, or a pipe) is read through a buffer.
+         *
+         * When running on multiple threads, the output of each command is
+         * still reported in script order. Once a command fails no further
+         * commands are started, and the first failing one in script order
+         * determines the result.
+         *
          * @param filename The pathname of the script.
+         * @param options The settings of the execution.
          *
          * @return What the last command executed returned.
          */
-        int executeFile(const std::string &filename);
+        int executeFile(const std::string &filename, ScriptOptions options = ScriptOptions());
+
+        /**
+         * @brief This function returns the statistics of the last script executed.
+         *
+         * @return The statistics of the last executeFile call that returned.
+         */
+        ScriptStatistics getLastScriptStatistics() const;
+
+        /**
+         * @brief Sets whether executeFile memory maps regular files.
+         *
+         * Turning it off makes scripts always go through the read buffer,
+         * which is useful to compare both paths.
+         *
+         * @param mapped Whether to memory map scripts.
+         */
+        void setMappedScripts(bool mapped);
+
+        /**
+         * @brief Sets whether commands write structured records instead of text.
+         *
+         * Commands get the writer for their records from getRecordWriter,
+         * which writes them as JSON Lines to the same sink as their text.
+         * The built-in commands help and stats then write records too, and
+         * so does the Console for unknown commands, so that the output can
+         * be parsed line by line. Commands which only write text are not
+         * affected, they should check isStructuredOutput.
+         *
+         * @param enabled Whether to write records.
+         */
+        void setStructuredOutput(bool enabled);
+
+        /**
+         * @brief Gets whether the command running on this thread should write records.
+         *
+         * @return Whether structured output is enabled, or a script runs with ScriptOptions::json.
+         */
+        bool isStructuredOutput() const;
+
+        /**
+         * @brief This function returns the writer for the records of the running command.
+         *
+         * It writes to the output sink of the command, and is disabled unless
+         * isStructuredOutput is true. The writer belongs to the calling
+         * thread, so it must not be kept beyond the command.
+         *
+         * @return The writer of the calling thread.
+         */
+        RecordWriter &getRecordWriter();
+
+        /**
+         * @brief Sets whether executeFile expands includes, variables and loops.
+         *
+         * Preprocessed scripts may use these directives, see
+         * ScriptPreprocessor for the details:
+         *
+         *     include common.txt
+         *     set host example.org
+         *     repeat 3
+         *     ping $host
+         *     end
+         *
+         * Scripts are expanded once before any of their commands run, so a
+         * missing include or variable fails the script without executing
+         * anything. Loop bodies and included files are read and tokenized
+         * only once. Commands named like a directive cannot be used in such
+         * scripts.
+         *
+         * @param enabled Whether to preprocess scripts.
+         */
+        void setScriptPreprocessing(bool enabled);
+
+        /**
+         * @brief Sets whether executeFile keeps the scripts it executes in memory.
+         *
+         * Cached scripts are stored already split into commands, so running
+         * them again does neither read nor tokenize them. A script is read
+         * again when its size or modification time changes, and its commands
+         * are looked up again when the registered commands change. Only
+         * regular files are cached.
+         *
+         * @param enabled Whether to cache scripts.
+         */
+        void setScriptCaching(bool enabled);
+
+        /**
+         * @brief Sets whether executed commands are counted and timed.
+         *
+         * Recording is off by default. When on, each execution costs two
+         * clock reads and a few atomic increments on the command. The
+         * statistics are kept per registered command, so re-registering a
+         * command starts it over.
+         *
+         * @param enabled Whether to record statistics.
+         */
+        void setCommandStatistics(bool enabled);
+
+        /**
+         * @brief This function returns the recorded statistics of all registered commands.
+         *
+         * It can be called from any thread, while commands are executing.
+         *
+         * @return The statistics in order of the command names.
+         */
+        std::vector<CommandStatistics> getCommandStatistics() const;
+
+        /**
+         * @brief This function forgets the statistics recorded so far.
+         */
+        void resetCommandStatistics();
+
+        /**
+         * @brief Sets where the commands read as input are recorded.
+         *
+         * Each line read by readLine or processInput is recorded with the
+         * time it started, how long it took and what it returned, so that
+         * the session can be replayed later with SessionReplayer. Commands
+         * executed through executeCommand or by scripts are not recorded on
+         * their own. The built-in "record" command sets a recorder as well.
+         *
+         * It should not be changed while another thread reads input.
+         *
+         * @param recorder The recorder, or nullptr to stop recording.
+         */
+        void setSessionRecorder(std::shared_ptr<SessionRecorder> recorder);
+
+        /**
+         * @brief Sets where the spans of time spent in the Console are traced to.
+         *
+         * Each command executed is traced as "execute", with its tokenization
+         * ("tokenize"), lookup ("lookup") and handler ("handler") nested in
+         * it. Scripts are traced as "executeFile", reading input as
+         * "readLine", with "input" waiting for the line and "flush" writing
+         * out the output before the prompt, and each completion as
+         * "complete". See TraceRing and ChromeTraceSink for sinks, and the
+         * built-in "trace" command.
+         *
+         * Without a sink tracing costs a null check per span, and building
+         * with CPP_READLINE_TRACING=0 compiles it out entirely. Replaced
+         * sinks are kept until the Console is destroyed, since commands on
+         * other threads may still be tracing to them; they are flushed.
+         *
+         * @param sink The sink, or nullptr to stop tracing.
+         */
+        void setTraceSink(std::shared_ptr<TraceSink> sink);
+
+        /**
+         * @brief This function returns the sink traced to, if any.
+         */
+        std::shared_ptr<TraceSink> getTraceSink() const;
 
         /**
          * @brief This function executes a single command from the user via stdin.
          *
+         * If the input is not a terminal, e.g. a pipe or a file, readline is
+         * bypassed: the input is read in large blocks and split into lines
+         * in place, no prompt is shown, nothing is added to the history, and
+         * the output sink is only flushed at the end of the input.
+         *
          * @return The result of the operation.
          */
         int readLine();
 
+        /**
+         * @brief This function returns whether readLine reads from a terminal.
+         *
+         * @return False if readLine runs in batch mode, without readline.
+         */
+        bool isInteractive() const;
+
+        /**
+         * @brief This function starts reading input without blocking, for use in an event loop.
+         *
+         * The prompt is shown, and from then on input is read by calling
+         * processInput whenever getInputFd() is readable. This uses the
+         * callback interface of GNU readline, so only one Console can read
+         * input this way at a time, and readLine must not be used meanwhile.
+         */
+        void installInputHandler();
+
+        /**
+         * @brief This function stops reading input started by installInputHandler.
+         */
+        void removeInputHandler();
+
+        /**
+         * @brief This function returns the file descriptor the Console reads input from.
+         *
+         * @return The descriptor to wait on before calling processInput.
+         */
+        int getInputFd() const;
+
+        /**
+         * @brief This function reads the input currently available and executes completed lines.
+         *
+         * It reads until it runs out of input or completes a line, which is
+         * then executed just like readLine would. Finished jobs are reported
+         * as well. At the end of the input Quit is returned, and the input
+         * handler is removed; after any other Quit the caller should remove
+         * it itself.
+         *
+         * @param result Set to the result of the executed line, if any.
+         *
+         * @return Whether a line was executed.
+         */
+        bool processInput(int &result);
+
+        /**
+         * @brief This function reserves the use of the GNU readline facilities to the calling Console instance.
+         *
+         * readLine and the input handler do this on their own. It is only
+         * needed to use GNU readline directly on behalf of this Console.
+         * Switching only swaps pointers, so it takes constant time whatever
+         * the length of the histories.
+         */
+        void reserveConsole();
+
+        /**
+         * @brief This function returns the completions for the last word of a line.
+         *
+         * These are the same matches TAB offers at the end of the line, in
+         * the same order. Arguments completed as filenames are returned as
+         * paths, with a trailing slash for directories.
+         *
+         * @param line The line typed so far.
+         *
+         * @return The candidates for the last word of line.
+         */
+        std::vector<std::string> getCompletions(std::string_view line) const;
+
     private:
         Console(const Console &) = delete;
 
@@ -128,11 +802,6 @@ namespace CppReadline {
          */
         void saveState();
 
-        /**
-         * @brief This function reserves the use of the GNU readline facilities to the calling Console instance.
-         */
-        void reserveConsole();
-
         // GNU newline interface to our commands.
         using commandCompleterFunction = char **(const char *text, int start, int end);
         using commandIteratorFunction = char *(const char *text, int state);
@@ -141,7 +810,47 @@ namespace CppReadline {
         static commandCompleterFunction getCommandCompletions;
         static commandIteratorFunction commandIterator;
         static argumentIteratorFunction argumentIterator;
+
+        // The incremental search bound to Ctrl-R while the history is indexed.
+        static int historySearch(int count, int key);
+
+        // Reports finished jobs while readline waits for input.
+        static int jobEventHook();
+
+        // Receives the lines read through readline's callback interface.
+        static void lineHandler(char *buffer);
+
+        /**
+         * @brief This function handles a line read by readline, taking ownership of it.
+         */
+        int acceptLine(char *buffer);
     };
+
+    template <typename F, typename>
+    void Console::registerCommand(const std::string &s, F f, CommandOptions options) {
+        using Traits = HandlerTraits<F>;
+        using Values = typename Traits::Arguments;
+        using Parser = ArgumentParser<Values>;
+
+        auto usage = Parser::usage(s);
+        // The generated usage line documents the arguments in "help <command>".
+        if (!options.description.empty()) { options.description += '\n'; }
+        options.description += "Usage: " + usage;
+        auto handler = [this, f = std::move(f), usage = std::move(usage)](const ArgumentViews &input) mutable {
+            Values values;
+            if (!Parser::parse(input, values)) {
+                getOutputSink() << "Usage: " << usage << '\n';
+                return static_cast<int>(ReturnCode::Error);
+            }
+            if constexpr (std::is_void_v<typename Traits::Result>) {
+                std::apply(f, values);
+                return static_cast<int>(ReturnCode::Ok);
+            } else {
+                return static_cast<int>(std::apply(f, values));
+            }
+        };
+        registerCommand(s, CommandViewFunction{std::move(handler), Parser::candidates()}, std::move(options));
+    }
 }
 
 #endif
@@ -0,0 +1,282 @@
+#include "ConsoleServer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace CppReadline {
+    namespace {
+
+        constexpr std::size_t readSize = 1 << 16;
+        // Sessions sending longer lines are dropped.
+        constexpr std::size_t maxLine = 1 << 20;
+        // Sessions with this much unsent output are not read from.
+        constexpr std::size_t maxPending = 1 << 20;
+
+    }  /* namespace  */
+
+    struct ConsoleServer::Session {
+        int fd;
+        // Received, but not executed yet.
+        std::string input;
+        // Results not sent yet, from sent on.
+        StringSink output;
+        std::size_t sent;
+        // Set once nothing is executed anymore, the session is closed once
+        // its output is sent.
+        bool closing;
+        std::uint32_t events;
+
+        explicit Session(int f) : fd(f), input(), output(), sent(0), closing(false), events(EPOLLIN) {}
+
+        std::size_t pending() const { return output.str().size() - sent; }
+    };
+
+    ConsoleServer::ConsoleServer(Console &console)
+            : console_(console), epoll_(epoll_create1(EPOLL_CLOEXEC)), wakeup_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+              stopped_(false), listeners_(), unixPaths_(), port_(0), sessions_() {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wakeup_;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &event);
+    }
+
+    ConsoleServer::~ConsoleServer() {
+        for (auto &session : sessions_) { ::close(session.first); }
+        for (int listener : listeners_) { ::close(listener); }
+        for (auto &path : unixPaths_) { unlink(path.c_str()); }
+        ::close(wakeup_);
+        ::close(epoll_);
+    }
+
+    bool ConsoleServer::listenUnix(const std::string &path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) { return false; }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        // Only a stale socket is replaced, never anything else found there.
+        struct stat info;
+        if (lstat(path.c_str(), &info) == 0) {
+            if (!S_ISSOCK(info.st_mode) || unlink(path.c_str()) != 0) { return false; }
+        } else if (errno != ENOENT) {
+            return false;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) { return false; }
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return false;
+        }
+        if (!listen(fd)) {
+            ::close(fd);
+            unlink(path.c_str());
+            return false;
+        }
+        // A path bound before was replaced above, it is only removed once.
+        if (std::find(unixPaths_.begin(), unixPaths_.end(), path) == unixPaths_.end()) { unixPaths_.push_back(path); }
+        return true;
+    }
+
+    bool ConsoleServer::listenTcp(const std::string &address, std::uint16_t port) {
+        sockaddr_in in{};
+        in.sin_family = AF_INET;
+        in.sin_port = htons(port);
+        if (inet_pton(AF_INET, address.c_str(), &in.sin_addr) != 1) { return false; }
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) { return false; }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        socklen_t size = sizeof(in);
+        if (bind(fd, reinterpret_cast<sockaddr *>(&in), sizeof(in)) != 0 ||
+            getsockname(fd, reinterpret_cast<sockaddr *>(&in), &size) != 0 || !listen(fd)) {
+            ::close(fd);
+            return false;
+        }
+        port_ = ntohs(in.sin_port);
+        return true;
+    }
+
+    std::uint16_t ConsoleServer::getPort() const {
+        return port_;
+    }
+
+    int ConsoleServer::getFd() const {
+        return epoll_;
+    }
+
+    void ConsoleServer::poll(int timeout) {
+        epoll_event events[64];
+        int count = epoll_wait(epoll_, events, 64, timeout);
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeup_) {
+                std::uint64_t value;
+                while (::read(wakeup_, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            if (std::find(listeners_.begin(), listeners_.end(), fd) != listeners_.end()) {
+                accept(fd);
+                continue;
+            }
+            auto it = sessions_.find(fd);
+            if (it == sessions_.end()) { continue; }
+            auto &session = *it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+                close(session);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) { read(session); }
+            if (events[i].events & EPOLLOUT) { write(session); }
+            update(session);
+        }
+    }
+
+    void ConsoleServer::run() {
+        while (!stopped_) { poll(-1); }
+        stopped_ = false;
+    }
+
+    void ConsoleServer::stop() {
+        stopped_ = true;
+        std::uint64_t value = 1;
+        if (::write(wakeup_, &value, sizeof(value)) < 0) {}
+    }
+
+    std::size_t ConsoleServer::getSessionCount() const {
+        return sessions_.size();
+    }
+
+    bool ConsoleServer::listen(int fd) {
+        if (::listen(fd, SOMAXCONN) != 0) { return false; }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) { return false; }
+        listeners_.push_back(fd);
+        return true;
+    }
+
+    void ConsoleServer::accept(int listener) {
+        int fd;
+        while ((fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            // Results are small and come one after the other, do not hold them back.
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                continue;
+            }
+            sessions_.emplace(fd, std::unique_ptr<Session>(new Session(fd)));
+        }
+    }
+
+    void ConsoleServer::read(Session &session) {
+        if (session.closing) { return; }
+        auto &input = session.input;
+        auto size = input.size();
+        input.resize(size + readSize);
+        auto received = ::recv(session.fd, &input[size], readSize, 0);
+        input.resize(size + static_cast<std::size_t>(std::max<ssize_t>(received, 0)));
+        if (received < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) { session.closing = true; }
+            return;
+        }
+        if (received == 0) {
+            // Like getline, a last line without newline is still executed.
+            if (!input.empty() && input.back() != '\n') { input.push_back('\n'); }
+            session.closing = true;
+        }
+        // Sending as much as possible right away saves waiting for EPOLLOUT.
+        write(session);
+    }
+
+    void ConsoleServer::write(Session &session) {
+        while (true) {
+            // Execute the lines received while there is room for their results.
+            std::size_t consumed = 0;
+            auto &input = session.input;
+            while (session.pending() < maxPending) {
+                auto newline = input.find('\n', consumed);
+                if (newline == std::string::npos) { break; }
+                std::string_view line(input.data() + consumed, newline - consumed);
+                if (!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+                consumed = newline + 1;
+
+                int result = console_.executeCommand(line, session.output);
+                session.output << "# " << result << '\n';
+                if (result == Console::ReturnCode::Quit) {
+                    session.closing = true;
+                    consumed = input.size();
+                    break;
+                }
+            }
+            input.erase(0, consumed);
+            if (input.size() > maxLine) {
+                session.closing = true;
+                input.clear();
+            }
+            if (session.closing && session.pending() == 0) { input.clear(); }
+
+            auto pending = session.pending();
+            if (pending == 0) { return; }
+            auto sent = ::send(session.fd, session.output.str().data() + session.sent, pending, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    // The client is gone, drop what it did not get.
+                    session.output.clear();
+                    session.sent = 0;
+                    session.closing = true;
+                    input.clear();
+                }
+                return;
+            }
+            session.sent += static_cast<std::size_t>(sent);
+            if (session.pending() > 0) { return; }
+            session.output.clear();
+            session.sent = 0;
+            // Everything was sent, so lines held back can run now.
+            if (input.find('\n') == std::string::npos) { return; }
+        }
+    }
+
+    void ConsoleServer::update(Session &session) {
+        auto pending = session.pending();
+        if (session.closing && pending == 0 && session.input.empty()) {
+            close(session);
+            return;
+        }
+        std::uint32_t events = 0;
+        if (!session.closing && pending < maxPending) { events |= EPOLLIN; }
+        if (pending > 0) { events |= EPOLLOUT; }
+        if (events == session.events) { return; }
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = session.fd;
+        epoll_ctl(epoll_, EPOLL_CTL_MOD, session.fd, &event);
+        session.events = events;
+    }
+
+    void ConsoleServer::close(Session &session) {
+        int fd = session.fd;
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        sessions_.erase(fd);
+    }
+}
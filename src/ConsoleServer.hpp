@@ -0,0 +1,138 @@
+#ifndef CONSOLE_CONSOLE_SERVER_HEADER_FILE
+#define CONSOLE_CONSOLE_SERVER_HEADER_FILE
+
+#include "Console.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class lets clients execute commands of a Console over sockets.
+     *
+     * Clients connect over Unix or TCP sockets and send one command per
+     * line. Each line is executed with executeCommand, its output goes to
+     * the session which sent it, and is followed by a status line holding
+     * the result: "# 0" for Ok. A command returning Quit ends the session,
+     * not the server.
+     *
+     * All sessions are served by a single epoll loop, on the thread calling
+     * run or poll, so the commands run one at a time. Clients may send many
+     * lines without waiting for their results; all complete lines received
+     * are executed and their results sent back in one go. A session which
+     * does not read its results is not read from either, until it catches
+     * up.
+     *
+     * Async commands are not supported over the server: they run as jobs
+     * of the Console, whose output goes to the Console's own sink once
+     * reported, so the session only gets the "[id] command" notice and
+     * the "# 0" of starting them.
+     */
+    class ConsoleServer {
+    public:
+        /**
+         * @brief Basic constructor.
+         *
+         * @param console The Console executing the commands, it must outlive the server.
+         */
+        explicit ConsoleServer(Console &console);
+
+        /**
+         * @brief Basic destructor, closes all sessions and listening sockets.
+         *
+         * The Unix sockets created by listenUnix are removed again.
+         */
+        ~ConsoleServer();
+
+        /**
+         * @brief This function accepts sessions on a Unix socket.
+         *
+         * @param path The pathname of the socket, an existing socket there is
+         *             replaced. Anything else there makes the call fail.
+         *
+         * @return Whether the socket could be created.
+         */
+        bool listenUnix(const std::string &path);
+
+        /**
+         * @brief This function accepts sessions on a TCP socket.
+         *
+         * @param address The IPv4 address to listen on, e.g. "127.0.0.1".
+         * @param port The port to listen on, 0 picks a free one, see getPort.
+         *
+         * @return Whether the socket could be created.
+         */
+        bool listenTcp(const std::string &address, std::uint16_t port);
+
+        /**
+         * @brief This function returns the port of the last TCP socket listened on.
+         */
+        std::uint16_t getPort() const;
+
+        /**
+         * @brief This function returns the descriptor of the event loop.
+         *
+         * It turns readable whenever poll has something to do, so the server
+         * can be driven from an existing event loop.
+         */
+        int getFd() const;
+
+        /**
+         * @brief This function waits for and handles the events of the sessions.
+         *
+         * @param timeout The longest time to wait in milliseconds, -1 waits indefinitely.
+         */
+        void poll(int timeout);
+
+        /**
+         * @brief This function handles events until stop is called.
+         */
+        void run();
+
+        /**
+         * @brief This function makes run return, it can be called from any thread.
+         */
+        void stop();
+
+        /**
+         * @brief This function returns the number of connected sessions.
+         */
+        std::size_t getSessionCount() const;
+
+    private:
+        ConsoleServer(const ConsoleServer &) = delete;
+
+        ConsoleServer &operator=(const ConsoleServer &) = delete;
+
+        struct Session;
+
+        bool listen(int fd);
+
+        void accept(int listener);
+
+        void read(Session &session);
+
+        void write(Session &session);
+
+        // Updates the events waited for, or closes the session when done.
+        void update(Session &session);
+
+        void close(Session &session);
+
+        Console &console_;
+        int epoll_;
+        int wakeup_;
+        std::atomic<bool> stopped_;
+        std::vector<int> listeners_;
+        // The sockets created by listenUnix, removed on destruction.
+        std::vector<std::string> unixPaths_;
+        std::uint16_t port_;
+        std::unordered_map<int, std::unique_ptr<Session>> sessions_;
+    };
+}
+
+#endif
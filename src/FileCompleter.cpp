@@ -0,0 +1,104 @@
+#include "FileCompleter.hpp"
+
+#include <algorithm>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace CppReadline {
+    namespace {
+
+        bool endsWith(const std::string &name, const std::string &suffix) {
+            return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+    }  /* namespace  */
+
+    FileCompleter::FileCompleter() : mutex_(), listings_(), capacity_(64), uses_(0) {}
+
+    void FileCompleter::complete(std::string_view text, const Extensions &extensions, Names &matches) {
+        matches.clear();
+        auto slash = text.rfind('/');
+        std::string_view directory = slash == std::string_view::npos ? std::string_view() : text.substr(0, slash + 1);
+        std::string_view prefix = slash == std::string_view::npos ? text : text.substr(slash + 1);
+        bool hidden = !prefix.empty() && prefix[0] == '.';
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto *listed = listing(directory.empty() ? std::string(".") : std::string(directory));
+        if (!listed) { return; }
+
+        auto &entries = listed->entries;
+        auto it = std::lower_bound(entries.begin(), entries.end(), prefix,
+                                   [](const Entry &entry, std::string_view p) { return entry.name < p; });
+        for (; it != entries.end() && it->name.compare(0, prefix.size(), prefix) == 0; ++it) {
+            if (!hidden && it->name[0] == '.') { continue; }
+            if (!it->directory && !extensions.empty() &&
+                std::none_of(extensions.begin(), extensions.end(),
+                             [&it](const std::string &extension) { return endsWith(it->name, extension); })) {
+                continue;
+            }
+            std::string path(directory);
+            path += it->name;
+            if (it->directory) { path += '/'; }
+            matches.push_back(std::move(path));
+        }
+    }
+
+    void FileCompleter::setCapacity(std::size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        evict();
+    }
+
+    void FileCompleter::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listings_.clear();
+    }
+
+    const FileCompleter::Listing *FileCompleter::listing(const std::string &directory) {
+        struct stat info;
+        if (stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) { return nullptr; }
+        std::int64_t modified = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+
+        auto it = listings_.find(directory);
+        if (it == listings_.end() || it->second.modified != modified) {
+            std::vector<Entry> entries;
+            if (!read(directory, entries)) { return nullptr; }
+            it = listings_.insert_or_assign(directory, Listing{modified, std::move(entries), 0}).first;
+        }
+        it->second.lastUse = ++uses_;
+        auto *listed = &it->second;
+        // Never drops the listing just used, it is the most recent.
+        evict();
+        return listed;
+    }
+
+    bool FileCompleter::read(const std::string &directory, std::vector<Entry> &entries) {
+        DIR *dir = opendir(directory.c_str());
+        if (!dir) { return false; }
+        while (auto *entry = readdir(dir)) {
+            std::string name(entry->d_name);
+            if (name == "." || name == "..") { continue; }
+            bool isDirectory = entry->d_type == DT_DIR;
+            // Some filesystems do not tell, and links may point to directories.
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat info;
+                auto path = directory + "/" + name;
+                isDirectory = stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+            }
+            entries.push_back(Entry{std::move(name), isDirectory});
+        }
+        closedir(dir);
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.name < b.name; });
+        return true;
+    }
+
+    void FileCompleter::evict() {
+        while (listings_.size() > capacity_ && listings_.size() > 1) {
+            auto oldest = std::min_element(listings_.begin(), listings_.end(), [](const auto &a, const auto &b) {
+                return a.second.lastUse < b.second.lastUse;
+            });
+            listings_.erase(oldest);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef CONSOLE_FILE_COMPLETER_HEADER_FILE
+#define CONSOLE_FILE_COMPLETER_HEADER_FILE
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class completes filenames from cached directory listings.
+     *
+     * Each directory is read once and kept sorted, so completing a prefix
+     * only touches the matching names however large the directory is. A
+     * listing is read again once the modification time of its directory
+     * changes, which only costs a stat per completion otherwise.
+     *
+     * All functions can be called concurrently.
+     */
+    class FileCompleter {
+    public:
+        using Names = std::vector<std::string>;
+        // Names of files to offer must end with one of these, if any are given.
+        using Extensions = std::vector<std::string>;
+
+        FileCompleter();
+
+        /**
+         * @brief This function replaces matches with the paths starting with text.
+         *
+         * Directories are always offered, with a trailing slash. Hidden
+         * entries are only offered if text names them, i.e. starts their
+         * name with a dot.
+         *
+         * @param text The path typed so far, relative to the working directory or absolute.
+         * @param extensions The extensions of files to offer, empty offers all.
+         * @param matches Where the matching paths are stored, in sorted order.
+         */
+        void complete(std::string_view text, const Extensions &extensions, Names &matches);
+
+        /**
+         * @brief Sets how many directory listings are kept, the least recently used are dropped first.
+         */
+        void setCapacity(std::size_t capacity);
+
+        /**
+         * @brief This function drops all cached listings.
+         */
+        void clear();
+
+    private:
+        FileCompleter(const FileCompleter &) = delete;
+
+        FileCompleter &operator=(const FileCompleter &) = delete;
+
+        struct Entry {
+            std::string name;
+            bool directory;
+        };
+
+        struct Listing {
+            std::int64_t modified;
+            std::vector<Entry> entries;
+            std::uint64_t lastUse;
+        };
+
+        // Returns nullptr if the directory cannot be read.
+        const Listing *listing(const std::string &directory);
+
+        static bool read(const std::string &directory, std::vector<Entry> &entries);
+
+        void evict();
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, Listing> listings_;
+        std::size_t capacity_;
+        std::uint64_t uses_;
+    };
+}
+
+#endif
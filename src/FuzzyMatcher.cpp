@@ -0,0 +1,133 @@
+#include "FuzzyMatcher.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace CppReadline {
+    namespace {
+
+        // Scores in the spirit of fzf.
+        constexpr int matchScore = 16;
+        constexpr int gapStart = -3;
+        constexpr int gapExtension = -1;
+        constexpr int boundaryBonus = matchScore / 2;
+        constexpr int camelBonus = boundaryBonus - 1;
+        constexpr int consecutiveBonus = 4;
+
+        char lower(char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        bool isWordChar(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        }
+
+        // The bonus of matching the character at i.
+        int bonus(std::string_view text, std::size_t i) {
+            if (i == 0 || !isWordChar(text[i - 1])) { return isWordChar(text[i]) ? boundaryBonus : 0; }
+            bool upper = text[i] >= 'A' && text[i] <= 'Z';
+            bool previousLower = text[i - 1] >= 'a' && text[i - 1] <= 'z';
+            return upper && previousLower ? camelBonus : 0;
+        }
+
+    }  /* namespace  */
+
+    FuzzyMatcher::FuzzyMatcher() : candidates_(), masks_() {}
+
+    FuzzyMatcher::FuzzyMatcher(Names candidates) : candidates_(std::move(candidates)), masks_() {
+        masks_.reserve(candidates_.size());
+        for (auto &candidate : candidates_) { masks_.push_back(mask(candidate)); }
+    }
+
+    const FuzzyMatcher::Names &FuzzyMatcher::candidates() const {
+        return candidates_;
+    }
+
+    void FuzzyMatcher::match(std::string_view pattern, Names &matches) const {
+        matches.clear();
+        auto required = mask(pattern);
+        auto count = masks_.size();
+
+        // Kept free of branches, so that it is vectorized.
+        std::vector<unsigned char> possible(count);
+        const std::uint64_t *masks = masks_.data();
+        unsigned char *out = possible.data();
+        for (std::size_t i = 0; i < count; ++i) {
+            // The missing characters, folded to 32 bits: plain SSE2 lacks
+            // 64 bit comparisons.
+            auto missing = ~masks[i] & required;
+            out[i] = static_cast<std::uint32_t>(missing | missing >> 32) == 0;
+        }
+
+        std::vector<std::pair<int, std::size_t>> scored;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!possible[i]) { continue; }
+            int s = score(pattern, candidates_[i]);
+            if (s >= 0) { scored.emplace_back(s, i); }
+        }
+        std::sort(scored.begin(), scored.end(), [this](const auto &a, const auto &b) {
+            if (a.first != b.first) { return a.first > b.first; }
+            auto &x = candidates_[a.second], &y = candidates_[b.second];
+            return x.size() != y.size() ? x.size() < y.size() : x < y;
+        });
+
+        matches.reserve(scored.size());
+        for (auto &match : scored) { matches.push_back(candidates_[match.second]); }
+    }
+
+    int FuzzyMatcher::score(std::string_view pattern, std::string_view candidate) {
+        if (pattern.empty()) { return 0; }
+
+        // Find where the first occurrence of the pattern ends...
+        std::size_t p = 0, end = 0;
+        for (; end < candidate.size() && p < pattern.size(); ++end) {
+            if (lower(candidate[end]) == lower(pattern[p])) { ++p; }
+        }
+        if (p < pattern.size()) { return -1; }
+        // ...and walk back from there, for the shortest window ending there.
+        std::size_t start = end;
+        for (p = pattern.size(); p > 0; ) {
+            --start;
+            if (lower(candidate[start]) == lower(pattern[p - 1])) { --p; }
+        }
+
+        int total = 0;
+        bool inGap = false;
+        std::size_t previous = start;
+        p = 0;
+        for (std::size_t i = start; i < end; ++i) {
+            if (p < pattern.size() && lower(candidate[i]) == lower(pattern[p])) {
+                int b = bonus(candidate, i);
+                bool consecutive = p > 0 && previous + 1 == i;
+                if (consecutive) { b = std::max(b, consecutiveBonus); }
+                total += matchScore + (p == 0 ? 2 * b : b);
+                previous = i;
+                inGap = false;
+                ++p;
+            } else {
+                total += inGap ? gapExtension : gapStart;
+                inGap = true;
+            }
+        }
+        // Never below a non match.
+        return std::max(total, 0);
+    }
+
+    std::uint64_t FuzzyMatcher::mask(std::string_view text) {
+        std::uint64_t bits = 0;
+        for (char c : text) {
+            c = lower(c);
+            unsigned bit;
+            if (c >= 'a' && c <= 'z') {
+                bit = static_cast<unsigned>(c - 'a');
+            } else if (c >= '0' && c <= '9') {
+                bit = 26 + static_cast<unsigned>(c - '0');
+            } else {
+                // Everything else shares the remaining bits.
+                bit = 36 + static_cast<unsigned char>(c) % 28;
+            }
+            bits |= std::uint64_t(1) << bit;
+        }
+        return bits;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef CONSOLE_FUZZY_MATCHER_HEADER_FILE
+#define CONSOLE_FUZZY_MATCHER_HEADER_FILE
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class ranks candidates by how well they fuzzily match a pattern.
+     *
+     * A candidate matches if it contains all characters of the pattern in
+     * order, ignoring case. Matches are scored like fzf does: matched
+     * characters at word boundaries and consecutive runs score higher,
+     * gaps cost, and the first pattern character counts double.
+     *
+     * For every candidate a mask of the characters it contains is kept.
+     * Candidates missing any character of the pattern are ruled out by a
+     * branch free loop over the masks, which the compiler vectorizes, so
+     * only the remaining ones are actually scored.
+     */
+    class FuzzyMatcher {
+    public:
+        using Names = std::vector<std::string>;
+
+        FuzzyMatcher();
+
+        /**
+         * @brief Basic constructor.
+         *
+         * @param candidates The candidates to match, order does not matter.
+         */
+        explicit FuzzyMatcher(Names candidates);
+
+        /**
+         * @brief This function returns the candidates, in the order they were given.
+         */
+        const Names &candidates() const;
+
+        /**
+         * @brief This function replaces matches with the candidates matching pattern, best first.
+         *
+         * Equal scores are ordered shortest, then alphabetically first.
+         */
+        void match(std::string_view pattern, Names &matches) const;
+
+        /**
+         * @brief This function scores how well a candidate matches a pattern.
+         *
+         * @return The score, higher is better, or -1 if it does not match.
+         */
+        static int score(std::string_view pattern, std::string_view candidate);
+
+    private:
+        static std::uint64_t mask(std::string_view text);
+
+        Names candidates_;
+        std::vector<std::uint64_t> masks_;
+    };
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "HistoryFile.hpp"
+#include "LineScanner.hpp"
+
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace CppReadline {
+    HistoryFile::HistoryFile() : filename_(), fd_(-1), limit_(0), excess_(0) {}
+
+    HistoryFile::~HistoryFile() {
+        close();
+    }
+
+    bool HistoryFile::open(const std::string &filename) {
+        close();
+        fd_ = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (fd_ < 0) { return false; }
+        filename_ = filename;
+        return true;
+    }
+
+    void HistoryFile::close() {
+        if (fd_ >= 0) { ::close(fd_); }
+        fd_ = -1;
+        filename_.clear();
+        excess_ = 0;
+    }
+
+    bool HistoryFile::isOpen() const {
+        return fd_ >= 0;
+    }
+
+    void HistoryFile::load(std::size_t limit, const std::function<void(std::string_view)> &add) {
+        LineScanner input;
+        if (filename_.empty() || !input.open(filename_)) { return; }
+        input.tail(limit);
+
+        std::string_view line;
+        while (input.next(line)) {
+            if (!line.empty()) { add(line); }
+        }
+        // What was skipped is not counted, so a file left large by earlier
+        // runs is compacted after another limit entries at the latest.
+        excess_ = 0;
+    }
+
+    bool HistoryFile::append(std::string_view entry) {
+        if (fd_ < 0) { return false; }
+        // A single write, so that concurrent appenders do not interleave.
+        char newline = '\n';
+        iovec parts[2] = {{const_cast<char *>(entry.data()), entry.size()}, {&newline, 1}};
+        if (writev(fd_, parts, 2) < 0) { return false; }
+        return limit_ && ++excess_ > limit_;
+    }
+
+    void HistoryFile::compact(const Entries &entries) {
+        if (fd_ < 0) { return; }
+        auto temporary = filename_ + ".tmp";
+        // Private like the history file itself, since it replaces it, even
+        // if left behind by an earlier run with other permissions.
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0) { return; }
+        FILE *file = fchmod(fd, 0600) == 0 ? fdopen(fd, "w") : nullptr;
+        if (!file) {
+            ::close(fd);
+            std::remove(temporary.c_str());
+            return;
+        }
+        for (auto entry : entries) {
+            std::fwrite(entry.data(), 1, entry.size(), file);
+            std::fputc('\n', file);
+        }
+        if (std::fclose(file) != 0 || std::rename(temporary.c_str(), filename_.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            return;
+        }
+        // Keep appending to the new file.
+        auto filename = filename_;
+        open(filename);
+    }
+
+    void HistoryFile::setLimit(std::size_t limit) {
+        limit_ = limit;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef CONSOLE_HISTORY_FILE_HEADER_FILE
+#define CONSOLE_HISTORY_FILE_HEADER_FILE
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class persists a history as a file with one entry per line.
+     *
+     * Entries are appended with a single write each, so the file is never
+     * rewritten while it grows, and several processes can append to it.
+     * With a limit the file is compacted once it holds twice as many
+     * entries, which keeps it in proportion without rewriting it often.
+     */
+    class HistoryFile {
+    public:
+        using Entries = std::vector<std::string_view>;
+
+        HistoryFile();
+
+        ~HistoryFile();
+
+        /**
+         * @brief This function opens a file for appending, creating it if needed.
+         *
+         * @return Whether the file could be opened.
+         */
+        bool open(const std::string &filename);
+
+        /**
+         * @brief This function stops persisting to the file.
+         */
+        void close();
+
+        /**
+         * @brief This function returns whether a file is open.
+         */
+        bool isOpen() const;
+
+        /**
+         * @brief This function reads the last entries of the file.
+         *
+         * The file is memory mapped and only its end is read, so loading a
+         * large file with a small limit does not depend on its size.
+         *
+         * @param limit The number of entries to read, 0 reads all of them.
+         * @param add Called for each entry read, oldest first.
+         */
+        void load(std::size_t limit, const std::function<void(std::string_view)> &add);
+
+        /**
+         * @brief This function appends an entry to the file.
+         *
+         * @return Whether the file needs to be compacted, see compact.
+         */
+        bool append(std::string_view entry);
+
+        /**
+         * @brief This function replaces the contents of the file with the given entries.
+         *
+         * The new file is written next to the old one and renamed over it.
+         */
+        void compact(const Entries &entries);
+
+        /**
+         * @brief Sets the number of entries kept, 0 never compacts the file.
+         */
+        void setLimit(std::size_t limit);
+
+    private:
+        HistoryFile(const HistoryFile &) = delete;
+
+        HistoryFile &operator=(const HistoryFile &) = delete;
+
+        std::string filename_;
+        int fd_;
+        std::size_t limit_;
+        // Entries in the file beyond the limit, as far as this process knows.
+        std::size_t excess_;
+    };
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "HistoryIndex.hpp"
+
+#include <algorithm>
+
+namespace CppReadline {
+    namespace {
+
+        std::uint32_t trigram(const char *c) {
+            return static_cast<std::uint32_t>(static_cast<unsigned char>(c[0])) << 16 |
+                   static_cast<std::uint32_t>(static_cast<unsigned char>(c[1])) << 8 |
+                   static_cast<std::uint32_t>(static_cast<unsigned char>(c[2]));
+        }
+
+    }  /* namespace  */
+
+    HistoryIndex::HistoryIndex() : mutex_(), entries_(), first_(0), limit_(0), dropped_(0), trigrams_() {}
+
+    void HistoryIndex::add(std::string_view line) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.emplace_back(line);
+        index(first_ + entries_.size() - 1, entries_.back());
+        trim();
+    }
+
+    void HistoryIndex::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        first_ += entries_.size();
+        entries_.clear();
+        dropped_ = 0;
+        trigrams_.clear();
+    }
+
+    void HistoryIndex::setLimit(std::size_t limit) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        limit_ = limit;
+        trim();
+    }
+
+    std::size_t HistoryIndex::size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    void HistoryIndex::search(std::string_view text, std::size_t limit, Matches &matches,
+                              std::uint64_t before) const {
+        matches.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto end = std::min(before, first_ + entries_.size());
+        auto check = [&](std::uint64_t id) {
+            auto &line = entries_[id - first_];
+            if (line.find(text) == std::string::npos) { return; }
+            matches.push_back(Match{id, line});
+        };
+
+        if (text.size() < 3) {
+            for (auto id = end; id > first_ && matches.size() < limit; --id) { check(id - 1); }
+            return;
+        }
+
+        // Every match contains all trigrams of text, so the rarest one has
+        // the fewest candidates.
+        const Posting *rarest = nullptr;
+        for (std::size_t i = 0; i + 3 <= text.size(); ++i) {
+            auto it = trigrams_.find(trigram(text.data() + i));
+            if (it == trigrams_.end()) { return; }
+            if (!rarest || it->second.size() < rarest->size()) { rarest = &it->second; }
+        }
+        auto it = std::lower_bound(rarest->begin(), rarest->end(), end);
+        while (it != rarest->begin() && matches.size() < limit) {
+            auto id = *--it;
+            if (id < first_) { break; }
+            check(id);
+        }
+    }
+
+    void HistoryIndex::index(std::uint64_t id, const std::string &line) {
+        for (std::size_t i = 0; i + 3 <= line.size(); ++i) {
+            auto &posting = trigrams_[trigram(line.data() + i)];
+            // Repeated trigrams of the same entry are only listed once.
+            if (posting.empty() || posting.back() != id) { posting.push_back(id); }
+        }
+    }
+
+    void HistoryIndex::trim() {
+        if (!limit_ || entries_.size() <= limit_) { return; }
+        auto dropped = entries_.size() - limit_;
+        entries_.erase(entries_.begin(), entries_.begin() + static_cast<std::ptrdiff_t>(dropped));
+        first_ += dropped;
+
+        // Postings are only appended to, so the ids of dropped entries are
+        // removed all at once, when they make up about half of them.
+        dropped_ += dropped;
+        if (dropped_ < entries_.size()) { return; }
+        dropped_ = 0;
+        trigrams_.clear();
+        for (std::size_t i = 0; i < entries_.size(); ++i) { index(first_ + i, entries_[i]); }
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef CONSOLE_HISTORY_INDEX_HEADER_FILE
+#define CONSOLE_HISTORY_INDEX_HEADER_FILE
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class finds the history entries containing a text.
+     *
+     * Each entry gets an increasing id, and a trigram index maps every
+     * trigram to the ids of the entries containing it. A search only looks
+     * at the entries sharing its rarest trigram, newest first, so it stops
+     * as soon as enough matches have been found. Texts shorter than a
+     * trigram fall back to scanning from the newest entry.
+     *
+     * All functions can be called concurrently.
+     */
+    class HistoryIndex {
+    public:
+        struct Match {
+            std::uint64_t id;
+            std::string line;
+        };
+        using Matches = std::vector<Match>;
+
+        static constexpr std::uint64_t Newest = std::numeric_limits<std::uint64_t>::max();
+
+        HistoryIndex();
+
+        /**
+         * @brief This function adds an entry as the newest one.
+         */
+        void add(std::string_view line);
+
+        /**
+         * @brief This function drops all entries.
+         */
+        void clear();
+
+        /**
+         * @brief Sets how many entries are kept, the oldest are dropped first. 0 keeps all.
+         */
+        void setLimit(std::size_t limit);
+
+        /**
+         * @brief This function returns the number of entries.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief This function replaces matches with the entries containing text, newest first.
+         *
+         * @param text The text to look for.
+         * @param limit The maximum number of matches.
+         * @param matches Where the matches are stored.
+         * @param before Only entries with a smaller id are considered.
+         */
+        void search(std::string_view text, std::size_t limit, Matches &matches, std::uint64_t before = Newest) const;
+
+    private:
+        HistoryIndex(const HistoryIndex &) = delete;
+
+        HistoryIndex &operator=(const HistoryIndex &) = delete;
+
+        using Posting = std::vector<std::uint64_t>;
+
+        void index(std::uint64_t id, const std::string &line);
+
+        void trim();
+
+        mutable std::mutex mutex_;
+        std::deque<std::string> entries_;
+        // The id of the oldest entry. Smaller ids may still be in the
+        // postings, until they make up half of them and are rebuilt.
+        std::uint64_t first_;
+        std::size_t limit_;
+        // Entries dropped since the postings were last rebuilt.
+        std::size_t dropped_;
+        std::unordered_map<std::uint32_t, Posting> trigrams_;
+    };
+}
+
+#endif
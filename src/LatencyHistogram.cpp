@@ -0,0 +1,71 @@
+#include "LatencyHistogram.hpp"
+
+namespace CppReadline {
+    LatencyHistogram::LatencyHistogram() : buckets_(nullptr), total_(0), max_(0) {}
+
+    LatencyHistogram::~LatencyHistogram() {
+        delete[] buckets_.load();
+    }
+
+    void LatencyHistogram::record(std::uint64_t nanoseconds) {
+        auto *buckets = buckets_.load(std::memory_order_acquire);
+        if (!buckets) {
+            // Value initialization zeroes the counters.
+            auto *allocated = new Counter[BucketCount]();
+            if (buckets_.compare_exchange_strong(buckets, allocated, std::memory_order_acq_rel)) {
+                buckets = allocated;
+            } else {
+                delete[] allocated;
+            }
+        }
+        buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(nanoseconds, std::memory_order_relaxed);
+        auto max = max_.load(std::memory_order_relaxed);
+        while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {}
+    }
+
+    void LatencyHistogram::snapshot(Buckets &buckets) const {
+        buckets.clear();
+        auto *counters = buckets_.load(std::memory_order_acquire);
+        if (!counters) { return; }
+        for (std::size_t i = 0; i < BucketCount; ++i) {
+            auto count = counters[i].load(std::memory_order_relaxed);
+            if (count) { buckets.emplace_back(upperBound(i), count); }
+        }
+    }
+
+    std::uint64_t LatencyHistogram::total() const {
+        return total_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t LatencyHistogram::max() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    void LatencyHistogram::reset() {
+        if (auto *counters = buckets_.load(std::memory_order_acquire)) {
+            for (std::size_t i = 0; i < BucketCount; ++i) { counters[i].store(0, std::memory_order_relaxed); }
+        }
+        total_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t LatencyHistogram::bucketOf(std::uint64_t nanoseconds) {
+        constexpr std::uint64_t linear = std::uint64_t(1) << SubBucketBits;
+        // Small values get a bucket each.
+        if (nanoseconds < linear) { return static_cast<std::size_t>(nanoseconds); }
+        if (nanoseconds >> MaxExponent) { return BucketCount - 1; }
+        unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(nanoseconds));
+        // The bits right below the leading one select the linear bucket.
+        auto sub = (nanoseconds >> (exponent - SubBucketBits)) - linear;
+        return static_cast<std::size_t>(((exponent - SubBucketBits + 1) << SubBucketBits) + sub);
+    }
+
+    std::uint64_t LatencyHistogram::upperBound(std::size_t bucket) {
+        constexpr std::size_t linear = std::size_t(1) << SubBucketBits;
+        if (bucket < linear) { return bucket; }
+        unsigned shift = static_cast<unsigned>(bucket / linear - 1);
+        std::uint64_t lower = static_cast<std::uint64_t>(linear + bucket % linear) << shift;
+        return lower + (std::uint64_t(1) << shift) - 1;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef CONSOLE_LATENCY_HISTOGRAM_HEADER_FILE
+#define CONSOLE_LATENCY_HISTOGRAM_HEADER_FILE
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class counts durations in log-linear buckets.
+     *
+     * Each power of two is split into 8 linear buckets, so every duration is
+     * known within 12.5%, from single nanoseconds up to about 18 minutes.
+     * Recording is a handful of relaxed atomic operations and can happen
+     * from any number of threads. The buckets are only allocated by the
+     * first duration recorded.
+     */
+    class LatencyHistogram {
+    public:
+        // Pairs of the largest value of a bucket and the count in it.
+        using Buckets = std::vector<std::pair<std::uint64_t, std::uint64_t>>;
+
+        LatencyHistogram();
+
+        ~LatencyHistogram();
+
+        /**
+         * @brief This function counts a duration.
+         */
+        void record(std::uint64_t nanoseconds);
+
+        /**
+         * @brief This function replaces buckets with the non empty buckets, in increasing order.
+         */
+        void snapshot(Buckets &buckets) const;
+
+        /**
+         * @brief This function returns the sum of all durations recorded.
+         */
+        std::uint64_t total() const;
+
+        /**
+         * @brief This function returns the longest duration recorded.
+         */
+        std::uint64_t max() const;
+
+        /**
+         * @brief This function forgets all durations recorded.
+         *
+         * Durations recorded concurrently may or may not be kept.
+         */
+        void reset();
+
+    private:
+        LatencyHistogram(const LatencyHistogram &) = delete;
+
+        LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+        using Counter = std::atomic<std::uint64_t>;
+
+        static constexpr unsigned SubBucketBits = 3;
+        static constexpr unsigned MaxExponent = 40;
+        static constexpr std::size_t BucketCount = (MaxExponent - SubBucketBits + 1) << SubBucketBits;
+
+        static std::size_t bucketOf(std::uint64_t nanoseconds);
+
+        static std::uint64_t upperBound(std::size_t bucket);
+
+        std::atomic<Counter *> buckets_;
+        Counter total_;
+        Counter max_;
+    };
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "LineScanner.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace CppReadline {
+    namespace {
+
+        constexpr std::size_t blockSize = 1 << 16;
+
+    }  /* namespace  */
+
+    LineScanner::LineScanner()
+            : fd_(-1), ownsFd_(false), map_(nullptr), mapSize_(0), position_(0),
+              buffer_(), begin_(0), end_(0), eof_(false) {}
+
+    LineScanner::~LineScanner() {
+        close();
+    }
+
+    bool LineScanner::open(const std::string &filename, bool mapped) {
+        close();
+        if (filename == "-") {
+            open(STDIN_FILENO);
+            return true;
+        }
+
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { return false; }
+
+        struct stat info;
+        if (mapped && fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            mapSize_ = static_cast<std::size_t>(info.st_size);
+            if (mapSize_ == 0) {
+                // Nothing to map, and nothing to read either.
+                ::close(fd);
+                eof_ = true;
+                return true;
+            }
+            void *map = mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                ::close(fd);
+                madvise(map, mapSize_, MADV_SEQUENTIAL);
+                map_ = static_cast<const char *>(map);
+                return true;
+            }
+            mapSize_ = 0;
+        }
+
+        open(fd);
+        ownsFd_ = true;
+        return true;
+    }
+
+    void LineScanner::open(int fd) {
+        close();
+        fd_ = fd;
+        buffer_.resize(blockSize);
+    }
+
+    bool LineScanner::next(std::string_view &line) {
+        if (map_) {
+            if (position_ == mapSize_) { return false; }
+            auto start = map_ + position_;
+            auto newline = static_cast<const char *>(std::memchr(start, '\n', mapSize_ - position_));
+            auto size = newline ? static_cast<std::size_t>(newline - start) : mapSize_ - position_;
+            line = std::string_view(start, size);
+            position_ += newline ? size + 1 : size;
+            return true;
+        }
+
+        std::size_t searched = begin_;
+        while (true) {
+            auto start = buffer_.data() + searched;
+            auto newline = searched == end_ ? nullptr
+                                            : static_cast<const char *>(std::memchr(start, '\n', end_ - searched));
+            if (newline) {
+                line = std::string_view(buffer_.data() + begin_, static_cast<std::size_t>(newline - buffer_.data()) - begin_);
+                begin_ += line.size() + 1;
+                return true;
+            }
+            searched = end_;
+            if (eof_) {
+                if (begin_ == end_) { return false; }
+                line = std::string_view(buffer_.data() + begin_, end_ - begin_);
+                begin_ = end_;
+                return true;
+            }
+            // Keep the partial line, and read more after it.
+            searched -= begin_;
+            if (!fill()) { eof_ = true; }
+        }
+    }
+
+    bool LineScanner::tail(std::size_t lines) {
+        if (!map_) { return false; }
+        std::size_t end = mapSize_;
+        // The newline ending the last line does not start another one.
+        if (end > position_ && map_[end - 1] == '\n') { --end; }
+        while (lines > 0 && end > position_) {
+            auto newline = static_cast<const char *>(memrchr(map_ + position_, '\n', end - position_));
+            if (!newline) { return true; }
+            end = static_cast<std::size_t>(newline - map_);
+            if (--lines == 0) { position_ = end + 1; }
+        }
+        return true;
+    }
+
+    void LineScanner::close() {
+        if (map_) { munmap(const_cast<char *>(map_), mapSize_); }
+        if (ownsFd_) { ::close(fd_); }
+        fd_ = -1;
+        ownsFd_ = false;
+        map_ = nullptr;
+        mapSize_ = position_ = 0;
+        begin_ = end_ = 0;
+        eof_ = false;
+    }
+
+    bool LineScanner::isMapped() const {
+        return map_ != nullptr;
+    }
+
+    bool LineScanner::fill() {
+        if (fd_ < 0) { return false; }
+        if (begin_ > 0) {
+            std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        // Only a line longer than the whole buffer makes it grow.
+        if (end_ == buffer_.size()) { buffer_.resize(buffer_.size() * 2); }
+
+        ssize_t count;
+        do {
+            count = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) { return false; }
+        end_ += static_cast<std::size_t>(count);
+        return true;
+    }
+}
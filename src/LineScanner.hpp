@@ -0,0 +1,94 @@
+#ifndef CONSOLE_LINE_SCANNER_HEADER_FILE
+#define CONSOLE_LINE_SCANNER_HEADER_FILE
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class reads a file line by line without copying the lines.
+     *
+     * Regular files are memory mapped and the lines are views into the
+     * mapping. Anything that cannot be mapped (pipes, terminals, ...) is read
+     * in large blocks into a buffer that is reused for the whole file.
+     *
+     * Lines are split like std::getline does: the newline is not part of the
+     * line, and a last line without newline is still returned.
+     */
+    class LineScanner {
+    public:
+        LineScanner();
+
+        ~LineScanner();
+
+        /**
+         * @brief This function opens a file for scanning.
+         *
+         * @param filename The pathname of the file, "-" stands for stdin.
+         * @param mapped Whether regular files should be memory mapped.
+         *
+         * @return Whether the file could be opened.
+         */
+        bool open(const std::string &filename, bool mapped = true);
+
+        /**
+         * @brief This function scans an already open file descriptor through the buffer.
+         *
+         * The descriptor is not closed by the scanner.
+         */
+        void open(int fd);
+
+        /**
+         * @brief This function returns the next line.
+         *
+         * The view stays valid until the next call, or until the scanner is
+         * closed if the file is mapped.
+         *
+         * @return Whether there was a line left.
+         */
+        bool next(std::string_view &line);
+
+        /**
+         * @brief This function skips ahead to the last lines of a mapped file.
+         *
+         * Only the end of the file is touched, so this is cheap however
+         * large the file is.
+         *
+         * @param lines The number of lines to keep.
+         *
+         * @return Whether the file is mapped, otherwise nothing is skipped.
+         */
+        bool tail(std::size_t lines);
+
+        /**
+         * @brief This function releases the file.
+         */
+        void close();
+
+        /**
+         * @brief This function returns whether the file is memory mapped.
+         */
+        bool isMapped() const;
+
+    private:
+        LineScanner(const LineScanner &) = delete;
+
+        LineScanner &operator=(const LineScanner &) = delete;
+
+        bool fill();
+
+        int fd_;
+        bool ownsFd_;
+
+        const char *map_;
+        std::size_t mapSize_;
+        std::size_t position_;
+
+        std::vector<char> buffer_;
+        std::size_t begin_, end_;
+        bool eof_;
+    };
+}
+
+#endif
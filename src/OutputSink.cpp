@@ -0,0 +1,74 @@
+#include "OutputSink.hpp"
+
+#include <cstdio>
+#include <ostream>
+
+namespace CppReadline {
+    OutputSink::~OutputSink() = default;
+
+    void OutputSink::flush() {}
+
+    OutputSink &OutputSink::operator<<(double value) {
+        char buffer[32];
+        auto size = std::snprintf(buffer, sizeof(buffer), "%g", value);
+        write(std::string_view(buffer, static_cast<std::size_t>(size)));
+        return *this;
+    }
+
+    StreamSink::StreamSink(std::ostream &stream) : stream_(stream) {}
+
+    void StreamSink::write(std::string_view text) {
+        stream_.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    void StreamSink::flush() {
+        stream_.flush();
+    }
+
+    StringSink::StringSink() : buffer_() {}
+
+    void StringSink::write(std::string_view text) {
+        buffer_.append(text.data(), text.size());
+    }
+
+    const std::string &StringSink::str() const {
+        return buffer_;
+    }
+
+    void StringSink::clear() {
+        buffer_.clear();
+    }
+
+    BufferedSink::BufferedSink(std::ostream &stream, std::size_t threshold)
+            : stream_(stream), threshold_(threshold), mutex_(), buffer_() {
+        buffer_.reserve(threshold);
+    }
+
+    BufferedSink::~BufferedSink() {
+        flush();
+    }
+
+    void BufferedSink::write(std::string_view text) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer_.append(text.data(), text.size());
+        if (buffer_.size() >= threshold_) { writeOut(); }
+    }
+
+    void BufferedSink::flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        writeOut();
+        stream_.flush();
+    }
+
+    void BufferedSink::setThreshold(std::size_t threshold) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threshold_ = threshold;
+        if (buffer_.size() >= threshold_) { writeOut(); }
+    }
+
+    void BufferedSink::writeOut() {
+        if (buffer_.empty()) { return; }
+        stream_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+}
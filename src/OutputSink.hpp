@@ -0,0 +1,128 @@
+#ifndef CONSOLE_OUTPUT_SINK_HEADER_FILE
+#define CONSOLE_OUTPUT_SINK_HEADER_FILE
+
+#include <charconv>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace CppReadline {
+    /**
+     * @brief This is the interface the Console writes all of its output through.
+     *
+     * Implementations only need to provide write(); the stream operators
+     * format their arguments without going through std::ostream.
+     */
+    class OutputSink {
+    public:
+        virtual ~OutputSink();
+
+        /**
+         * @brief This function writes some text.
+         */
+        virtual void write(std::string_view text) = 0;
+
+        /**
+         * @brief This function pushes buffered text, if any, to its final destination.
+         */
+        virtual void flush();
+
+        OutputSink &operator<<(std::string_view text) {
+            write(text);
+            return *this;
+        }
+
+        OutputSink &operator<<(char c) {
+            write(std::string_view(&c, 1));
+            return *this;
+        }
+
+        template <typename T, typename = std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+        OutputSink &operator<<(T value) {
+            char buffer[24];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            write(std::string_view(buffer, static_cast<std::size_t>(result.ptr - buffer)));
+            return *this;
+        }
+
+        // Formats like std::ostream does by default.
+        OutputSink &operator<<(double value);
+    };
+
+    /**
+     * @brief This sink forwards everything to an std::ostream as soon as it is written.
+     */
+    class StreamSink : public OutputSink {
+    public:
+        explicit StreamSink(std::ostream &stream);
+
+        void write(std::string_view text) override;
+
+        void flush() override;
+
+    private:
+        std::ostream &stream_;
+    };
+
+    /**
+     * @brief This sink collects output in memory.
+     */
+    class StringSink : public OutputSink {
+    public:
+        StringSink();
+
+        void write(std::string_view text) override;
+
+        /**
+         * @brief This function returns everything written since the last clear().
+         */
+        const std::string &str() const;
+
+        /**
+         * @brief This function discards the collected output, keeping its storage.
+         */
+        void clear();
+
+    private:
+        std::string buffer_;
+    };
+
+    /**
+     * @brief This sink collects output and forwards it to an std::ostream in large blocks.
+     *
+     * The block is written out once it reaches the threshold, on flush(),
+     * and on destruction. The Console also flushes it before each prompt.
+     *
+     * Commands writing to the same stream directly should write through the
+     * sink instead, or their output may overtake the buffered one.
+     *
+     * The sink can be written to from multiple threads.
+     */
+    class BufferedSink : public OutputSink {
+    public:
+        explicit BufferedSink(std::ostream &stream, std::size_t threshold = 1 << 16);
+
+        ~BufferedSink() override;
+
+        void write(std::string_view text) override;
+
+        void flush() override;
+
+        /**
+         * @brief Sets the amount of buffered bytes that triggers a write out.
+         */
+        void setThreshold(std::size_t threshold);
+
+    private:
+        void writeOut();
+
+        std::ostream &stream_;
+        std::size_t threshold_;
+        std::mutex mutex_;
+        std::string buffer_;
+    };
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "RecordWriter.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace CppReadline {
+    RecordWriter::RecordWriter() : sink_(nullptr), buffer_(), size_(0), empty_(), afterKey_(false) {}
+
+    RecordWriter::RecordWriter(OutputSink &sink)
+            : sink_(&sink), buffer_(), size_(0), empty_(), afterKey_(false) {}
+
+    void RecordWriter::setSink(OutputSink *sink) {
+        if (sink == sink_) { return; }
+        sink_ = sink;
+        size_ = 0;
+        empty_.clear();
+        afterKey_ = false;
+    }
+
+    RecordWriter &RecordWriter::end() {
+        if (!sink_) { return *this; }
+        endObject();
+        if (empty_.empty()) {
+            put('\n');
+            flush();
+        }
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::key(std::string_view name) {
+        if (!sink_) { return *this; }
+        separate();
+        string(name);
+        put(':');
+        afterKey_ = true;
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::value(std::string_view text) {
+        if (!sink_) { return *this; }
+        separate();
+        string(text);
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::value(bool flag) {
+        if (!sink_) { return *this; }
+        separate();
+        put(flag ? std::string_view("true") : std::string_view("false"));
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::value(double number) {
+        if (!sink_) { return *this; }
+        separate();
+        if (!std::isfinite(number)) {
+            put(std::string_view("null"));
+            return *this;
+        }
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        put(std::string_view(buffer, static_cast<std::size_t>(result.ptr - buffer)));
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::value(std::nullptr_t) {
+        if (!sink_) { return *this; }
+        separate();
+        put(std::string_view("null"));
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::beginObject() {
+        if (!sink_) { return *this; }
+        separate();
+        put('{');
+        empty_.push_back(true);
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::endObject() {
+        if (!sink_ || empty_.empty()) { return *this; }
+        put('}');
+        empty_.pop_back();
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::beginArray() {
+        if (!sink_) { return *this; }
+        separate();
+        put('[');
+        empty_.push_back(true);
+        return *this;
+    }
+
+    RecordWriter &RecordWriter::endArray() {
+        if (!sink_ || empty_.empty()) { return *this; }
+        put(']');
+        empty_.pop_back();
+        return *this;
+    }
+
+    void RecordWriter::separate() {
+        if (afterKey_) {
+            afterKey_ = false;
+            return;
+        }
+        if (empty_.empty()) { return; }
+        if (!empty_.back()) { put(','); }
+        empty_.back() = false;
+    }
+
+    void RecordWriter::put(std::string_view text) {
+        if (size_ + text.size() > buffer_.size()) {
+            flush();
+            // Too long to be buffered, so it goes to the sink as it is.
+            if (text.size() > buffer_.size()) {
+                sink_->write(text);
+                return;
+            }
+        }
+        std::memcpy(buffer_.data() + size_, text.data(), text.size());
+        size_ += text.size();
+    }
+
+    void RecordWriter::put(char c) {
+        if (size_ == buffer_.size()) { flush(); }
+        buffer_[size_++] = c;
+    }
+
+    void RecordWriter::string(std::string_view text) {
+        put('"');
+        // Runs of characters which need no escaping are copied in one go.
+        std::size_t run = 0;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            auto c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') { continue; }
+            put(text.substr(run, i - run));
+            run = i + 1;
+            switch (c) {
+                case '"': put(std::string_view("\\\"")); break;
+                case '\\': put(std::string_view("\\\\")); break;
+                case '\n': put(std::string_view("\\n")); break;
+                case '\r': put(std::string_view("\\r")); break;
+                case '\t': put(std::string_view("\\t")); break;
+                default: {
+                    static const char digits[] = "0123456789abcdef";
+                    char escaped[] = {'\\', 'u', '0', '0', digits[c >> 4], digits[c & 0xf]};
+                    put(std::string_view(escaped, sizeof(escaped)));
+                }
+            }
+        }
+        put(text.substr(run));
+        put('"');
+    }
+
+    void RecordWriter::flush() {
+        if (size_ == 0) { return; }
+        sink_->write(std::string_view(buffer_.data(), size_));
+        size_ = 0;
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef CONSOLE_RECORD_WRITER_HEADER_FILE
+#define CONSOLE_RECORD_WRITER_HEADER_FILE
+
+#include "OutputSink.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class writes structured records to an OutputSink as JSON Lines.
+     *
+     * Each record is a JSON object on a line of its own. Values are
+     * formatted straight into a small fixed buffer, which is handed to the
+     * sink whenever it fills up and at the end of each record, so no
+     * strings are built for them:
+     *
+     *     writer.begin().field("host", host).field("latency", 0.25).end();
+     *
+     * Without a sink the writer is disabled, and all calls do nothing.
+     * Writing values the structure does not expect, e.g. a value without
+     * key within an object, produces invalid JSON.
+     */
+    class RecordWriter {
+    public:
+        RecordWriter();
+
+        explicit RecordWriter(OutputSink &sink);
+
+        /**
+         * @brief Sets where records are written to, nullptr disables the writer.
+         *
+         * It should only be changed between records, the rest of a record
+         * not ended yet is dropped.
+         */
+        void setSink(OutputSink *sink);
+
+        /**
+         * @brief This function returns whether records are written anywhere.
+         *
+         * Handlers can check this to skip collecting what they would write.
+         */
+        bool isEnabled() const { return sink_ != nullptr; }
+
+        /**
+         * @brief This function starts a record.
+         */
+        RecordWriter &begin() { return beginObject(); }
+
+        /**
+         * @brief This function ends a record, and hands it to the sink.
+         */
+        RecordWriter &end();
+
+        /**
+         * @brief This function writes the key of the next value within an object.
+         */
+        RecordWriter &key(std::string_view name);
+
+        RecordWriter &value(std::string_view text);
+
+        RecordWriter &value(const char *text) { return value(std::string_view(text)); }
+
+        RecordWriter &value(bool flag);
+
+        // Non-finite numbers are written as null, which JSON has no other way to represent.
+        RecordWriter &value(double number);
+
+        RecordWriter &value(std::nullptr_t);
+
+        template <typename T, typename = std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+        RecordWriter &value(T number) {
+            if (!sink_) { return *this; }
+            separate();
+            char buffer[24];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+            put(std::string_view(buffer, static_cast<std::size_t>(result.ptr - buffer)));
+            return *this;
+        }
+
+        /**
+         * @brief This function writes a key and its value.
+         */
+        template <typename T>
+        RecordWriter &field(std::string_view name, const T &v) {
+            return key(name).value(v);
+        }
+
+        RecordWriter &beginObject();
+
+        RecordWriter &endObject();
+
+        RecordWriter &beginArray();
+
+        RecordWriter &endArray();
+
+    private:
+        RecordWriter(const RecordWriter &) = delete;
+
+        RecordWriter &operator=(const RecordWriter &) = delete;
+
+        // Writes the comma needed before the next value, if any.
+        void separate();
+
+        void put(std::string_view text);
+
+        void put(char c);
+
+        void string(std::string_view text);
+
+        void flush();
+
+        OutputSink *sink_;
+        std::array<char, 512> buffer_;
+        std::size_t size_;
+        // Per open object or array, whether nothing has been written into it yet.
+        std::vector<bool> empty_;
+        bool afterKey_;
+    };
+}
+
+#endif
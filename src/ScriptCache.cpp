@@ -0,0 +1,129 @@
+#include "ScriptCache.hpp"
+#include "LineScanner.hpp"
+#include "Tokenizer.hpp"
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
+namespace CppReadline {
+    ScriptCache::ScriptCache() : mutex_(), entries_(), capacity_(16), uses_(0) {}
+
+    ScriptCache::Script ScriptCache::get(const std::string &filename, const CommandRegistry &registry,
+                                         bool preprocess, std::string &error) {
+        struct stat info;
+        if (stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) { return nullptr; }
+        std::int64_t size = info.st_size;
+        std::int64_t modified = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = entries_.find(filename);
+        if (it != entries_.end() && it->second.size == size && it->second.modified == modified &&
+            it->second.preprocessed == preprocess && isCurrent(*it->second.script)) {
+            auto &entry = it->second;
+            entry.lastUse = ++uses_;
+            if (entry.script->generation != registry.generation()) {
+                entry.script = resolve(*entry.script, registry);
+            }
+            return entry.script;
+        }
+        // Compiling reads the whole file, so do not block other scripts meanwhile.
+        lock.unlock();
+
+        auto script = compile(filename, registry, preprocess, error);
+        if (!script) { return nullptr; }
+
+        lock.lock();
+        entries_.insert_or_assign(filename, Entry{size, modified, preprocess, script, ++uses_});
+        evict();
+        return script;
+    }
+
+    void ScriptCache::setCapacity(std::size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        evict();
+    }
+
+    void ScriptCache::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+    }
+
+    ScriptCache::Script ScriptCache::compile(const std::string &filename, const CommandRegistry &registry,
+                                             bool preprocess, std::string &error) {
+        error.clear();
+        // The generation is taken first, so that commands registered while
+        // compiling cause a lookup on the next use.
+        auto generation = registry.generation();
+        if (preprocess) {
+            PreprocessedScript preprocessed;
+            if (!ScriptPreprocessor().preprocess(filename, preprocessed, error)) { return nullptr; }
+            auto text = std::make_shared<std::string>(std::move(preprocessed.text));
+            auto script = tokenize(std::move(text), preprocessed.lines, preprocessed.lineCount, registry, generation);
+            script->steps = std::move(preprocessed.steps);
+            script->sources = std::move(preprocessed.sources);
+            return script;
+        }
+
+        LineScanner input;
+        if (!input.open(filename)) { return nullptr; }
+
+        auto text = std::make_shared<std::string>();
+        std::vector<std::pair<std::size_t, std::size_t>> lines;
+        std::size_t lineCount = 0;
+        std::string_view line;
+        while (input.next(line)) {
+            ++lineCount;
+            if (!line.empty() && line[0] == '#') { continue; } // Ignore comments
+            lines.emplace_back(text->size(), line.size());
+            text->append(line.data(), line.size());
+        }
+        return tokenize(std::move(text), lines, lineCount, registry, generation);
+    }
+
+    std::shared_ptr<CompiledScript> ScriptCache::tokenize(std::shared_ptr<std::string> text,
+                                              const std::vector<std::pair<std::size_t, std::size_t>> &lines,
+                                              std::size_t lineCount, const CommandRegistry &registry,
+                                              std::uint64_t generation) {
+        std::shared_ptr<CompiledScript> script(new CompiledScript{text, {}, {}, {}, lineCount, generation});
+        script->lines.reserve(lines.size());
+        Tokenizer tokenizer;
+        for (auto &span : lines) {
+            std::string_view view(text->data() + span.first, span.second);
+            auto &tokens = tokenizer.tokenize(view);
+            auto command = tokens.empty() ? nullptr : registry.find(tokens[0]);
+            script->lines.push_back(CompiledScript::Line{view, tokens, std::move(command)});
+        }
+        return script;
+    }
+
+    bool ScriptCache::isCurrent(const CompiledScript &script) {
+        for (auto &source : script.sources) {
+            struct stat info;
+            if (stat(source.filename.c_str(), &info) != 0 || info.st_size != source.size ||
+                static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec != source.modified) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ScriptCache::Script ScriptCache::resolve(const CompiledScript &script, const CommandRegistry &registry) {
+        std::shared_ptr<CompiledScript> resolved(new CompiledScript(script));
+        resolved->generation = registry.generation();
+        for (auto &line : resolved->lines) {
+            line.command = line.tokens.empty() ? nullptr : registry.find(line.tokens[0]);
+        }
+        return resolved;
+    }
+
+    void ScriptCache::evict() {
+        while (entries_.size() > capacity_) {
+            auto oldest = std::min_element(entries_.begin(), entries_.end(), [](const auto &a, const auto &b) {
+                return a.second.lastUse < b.second.lastUse;
+            });
+            entries_.erase(oldest);
+        }
+    }
+}
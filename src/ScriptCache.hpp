@@ -0,0 +1,120 @@
+#ifndef CONSOLE_SCRIPT_CACHE_HEADER_FILE
+#define CONSOLE_SCRIPT_CACHE_HEADER_FILE
+
+#include "CommandRegistry.hpp"
+#include "ScriptPreprocessor.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This struct holds a script in the form executeFile runs it.
+     *
+     * The lines are already split into tokens, and their commands looked up
+     * in the registry as it was at the given generation.
+     *
+     * Preprocessed scripts list the steps the lines run in, all others run
+     * their lines in order.
+     */
+    struct CompiledScript {
+        struct Line {
+            std::string_view text;
+            std::vector<std::string_view> tokens;
+            // Null if the command was not registered.
+            CommandRegistry::Pointer command;
+        };
+
+        // The views of the lines point into this text.
+        std::shared_ptr<const std::string> text;
+        // Does not contain comments.
+        std::vector<Line> lines;
+        std::vector<PreprocessedScript::Step> steps;
+        // The files included, which must not change either.
+        std::vector<PreprocessedScript::Source> sources;
+        // Including comments, for the statistics.
+        std::size_t lineCount = 0;
+        std::uint64_t generation = 0;
+    };
+
+    /**
+     * @brief This class keeps the compiled form of recently executed scripts.
+     *
+     * Scripts are recognized by their path, and recompiled when their size
+     * or modification time changed. When the registry changed since a script
+     * was compiled only its commands are looked up again. Preprocessed
+     * scripts are also recompiled when one of the files they include changed.
+     */
+    class ScriptCache {
+    public:
+        using Script = std::shared_ptr<const CompiledScript>;
+
+        ScriptCache();
+
+        /**
+         * @brief This function returns the compiled form of a script.
+         *
+         * @param filename The pathname of the script.
+         * @param registry The commands to look up.
+         * @param preprocess Whether to expand the directives of ScriptPreprocessor.
+         * @param error Set if preprocessing fails.
+         *
+         * @return The script, or nullptr if it is not a readable regular file or invalid.
+         */
+        Script get(const std::string &filename, const CommandRegistry &registry, bool preprocess,
+                   std::string &error);
+
+        /**
+         * @brief This function compiles a script without caching it.
+         *
+         * Unlike get, this also accepts files which are not regular, e.g. "-" for stdin.
+         */
+        static Script compile(const std::string &filename, const CommandRegistry &registry, bool preprocess,
+                              std::string &error);
+
+        /**
+         * @brief Sets how many scripts are kept, the least recently used are dropped first.
+         */
+        void setCapacity(std::size_t capacity);
+
+        /**
+         * @brief This function drops all cached scripts.
+         */
+        void clear();
+
+    private:
+        ScriptCache(const ScriptCache &) = delete;
+
+        ScriptCache &operator=(const ScriptCache &) = delete;
+
+        struct Entry {
+            std::int64_t size, modified;
+            bool preprocessed;
+            Script script;
+            std::uint64_t lastUse;
+        };
+
+        static std::shared_ptr<CompiledScript> tokenize(std::shared_ptr<std::string> text,
+                               const std::vector<std::pair<std::size_t, std::size_t>> &lines,
+                               std::size_t lineCount, const CommandRegistry &registry, std::uint64_t generation);
+
+        // Whether none of the included files changed.
+        static bool isCurrent(const CompiledScript &script);
+
+        static Script resolve(const CompiledScript &script, const CommandRegistry &registry);
+
+        void evict();
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries_;
+        std::size_t capacity_;
+        std::uint64_t uses_;
+    };
+}
+
+#endif
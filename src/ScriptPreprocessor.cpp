@@ -0,0 +1,184 @@
+#include "ScriptPreprocessor.hpp"
+#include "LineScanner.hpp"
+#include "Tokenizer.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+#include <sys/stat.h>
+
+namespace CppReadline {
+    namespace {
+
+        // Deeper includes are most likely a mistake.
+        constexpr std::size_t maxIncludeDepth = 32;
+
+        bool isNameCharacter(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        // Returns the line without the first token and the separators around it.
+        std::string_view rest(std::string_view line, std::string_view token) {
+            auto view = line.substr(static_cast<std::size_t>(token.data() - line.data()) + token.size());
+            while (!view.empty() && Tokenizer::isSeparator(view.front())) { view.remove_prefix(1); }
+            while (!view.empty() && Tokenizer::isSeparator(view.back())) { view.remove_suffix(1); }
+            return view;
+        }
+
+        std::string relativeTo(const std::string &including, const std::string &filename) {
+            if (filename.empty() || filename[0] == '/' || including == "-") { return filename; }
+            auto slash = including.rfind('/');
+            if (slash == std::string::npos) { return filename; }
+            return including.substr(0, slash + 1) + filename;
+        }
+
+    }  /* namespace  */
+
+    ScriptPreprocessor::ScriptPreprocessor() : files_(), variables_(), including_(), repeats_() {}
+
+    bool ScriptPreprocessor::preprocess(const std::string &filename, PreprocessedScript &script, std::string &error) {
+        error.clear();
+        // A missing script is not an error within it.
+        if (!read(filename, script) || !process(filename, script, error)) { return false; }
+        // The main script is not a source, its caller checks it already.
+        script.sources.erase(std::remove_if(script.sources.begin(), script.sources.end(),
+                                            [&filename](const PreprocessedScript::Source &source) {
+                                                return source.filename == filename;
+                                            }), script.sources.end());
+        return true;
+    }
+
+    const ScriptPreprocessor::File *ScriptPreprocessor::read(const std::string &filename,
+                                                             PreprocessedScript &script) {
+        auto it = files_.find(filename);
+        if (it != files_.end()) { return it->second.get(); }
+
+        struct stat info;
+        bool regular = filename != "-" && stat(filename.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+        LineScanner input;
+        if (!input.open(filename)) { return nullptr; }
+        std::unique_ptr<File> file(new File());
+        std::string_view line;
+        while (input.next(line)) {
+            file->lines.emplace_back(file->text.size(), line.size());
+            file->text.append(line.data(), line.size());
+        }
+        if (regular) {
+            std::int64_t modified = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+            script.sources.push_back(PreprocessedScript::Source{filename, info.st_size, modified});
+        }
+        return files_.emplace(filename, std::move(file)).first->second.get();
+    }
+
+    bool ScriptPreprocessor::process(const std::string &filename, PreprocessedScript &script, std::string &error) {
+        auto *file = read(filename, script);
+        if (!file) {
+            error = "Could not read " + filename;
+            return false;
+        }
+        including_.push_back(filename);
+        auto openRepeats = repeats_.size();
+
+        Tokenizer tokenizer;
+        std::string line, missing;
+        std::size_t number = 0;
+        auto fail = [&](const std::string &message) {
+            error = filename + ":" + std::to_string(number) + ": " + message;
+            return false;
+        };
+
+        for (auto &span : file->lines) {
+            ++number;
+            ++script.lineCount;
+            std::string_view text(file->text.data() + span.first, span.second);
+            if (!text.empty() && text[0] == '#') { continue; } // Ignore comments
+            if (!substitute(text, line, missing)) { return fail("Unknown variable " + missing); }
+
+            auto &tokens = tokenizer.tokenize(line);
+            auto directive = tokens.empty() ? std::string_view() : tokens[0];
+            if (directive == "set") {
+                if (tokens.size() < 2) { return fail("Usage: set name text"); }
+                auto name = tokens[1];
+                if (!std::all_of(name.begin(), name.end(), isNameCharacter)) {
+                    return fail("Invalid variable name " + std::string(name));
+                }
+                variables_[std::string(name)] = std::string(rest(line, name));
+            } else if (directive == "include") {
+                if (tokens.size() != 2) { return fail("Usage: include filename"); }
+                auto included = relativeTo(filename, std::string(tokens[1]));
+                if (std::find(including_.begin(), including_.end(), included) != including_.end()) {
+                    return fail("The inclusion of " + included + " is circular");
+                }
+                if (including_.size() >= maxIncludeDepth) { return fail("Includes are nested too deeply"); }
+                if (!process(included, script, error)) {
+                    // Tell where the failing file was included from.
+                    error += "\n" + filename + ":" + std::to_string(number) + ": Included from here";
+                    return false;
+                }
+            } else if (directive == "repeat") {
+                std::size_t count = 0;
+                auto end = tokens.size() == 2 ? tokens[1].data() + tokens[1].size() : nullptr;
+                if (!end || std::from_chars(tokens[1].data(), end, count).ptr != end) {
+                    return fail("Usage: repeat count");
+                }
+                repeats_.push_back(script.steps.size());
+                script.steps.push_back(PreprocessedScript::Step{count, 0});
+            } else if (directive == "end") {
+                if (tokens.size() != 1 || repeats_.size() == openRepeats) { return fail("end without repeat"); }
+                script.steps[repeats_.back()].end = script.steps.size();
+                repeats_.pop_back();
+            } else {
+                script.steps.push_back(PreprocessedScript::Step{script.lines.size(), 0});
+                script.lines.emplace_back(script.text.size(), line.size());
+                script.text += line;
+            }
+        }
+
+        if (repeats_.size() != openRepeats) { return fail("repeat without end"); }
+        including_.pop_back();
+        return true;
+    }
+
+    bool ScriptPreprocessor::substitute(std::string_view line, std::string &result, std::string &missing) const {
+        result.clear();
+        std::size_t i = 0;
+        while (true) {
+            auto dollar = line.find('$', i);
+            result.append(line.data() + i, std::min(dollar, line.size()) - i);
+            if (dollar == std::string_view::npos) { return true; }
+            i = dollar + 1;
+
+            if (i < line.size() && line[i] == '$') {
+                result += '$';
+                ++i;
+                continue;
+            }
+            std::string_view name;
+            if (i < line.size() && line[i] == '{') {
+                auto close = line.find('}', i);
+                if (close == std::string_view::npos) {
+                    result += '$';
+                    continue;
+                }
+                name = line.substr(i + 1, close - i - 1);
+                i = close + 1;
+            } else {
+                auto end = i;
+                while (end < line.size() && isNameCharacter(line[end])) { ++end; }
+                name = line.substr(i, end - i);
+                i = end;
+            }
+            // A lone dollar is kept as it is.
+            if (name.empty()) {
+                result += '$';
+                continue;
+            }
+            auto it = variables_.find(std::string(name));
+            if (it == variables_.end()) {
+                missing.assign(name.data(), name.size());
+                return false;
+            }
+            result += it->second;
+        }
+    }
+}
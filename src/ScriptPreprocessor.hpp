@@ -0,0 +1,102 @@
+#ifndef CONSOLE_SCRIPT_PREPROCESSOR_HEADER_FILE
+#define CONSOLE_SCRIPT_PREPROCESSOR_HEADER_FILE
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This struct holds a script after preprocessing, before its lines are tokenized.
+     */
+    struct PreprocessedScript {
+        // A step either runs a line, or repeats the steps after it up to end.
+        struct Step {
+            std::size_t line;  // Index into lines, or the count of a repeat.
+            std::size_t end;   // Zero unless the step is a repeat.
+
+            bool isRepeat() const { return end != 0; }
+        };
+
+        // A file included by the script, and the state it was read in.
+        struct Source {
+            std::string filename;
+            std::int64_t size, modified;
+        };
+
+        // The commands left after substituting the variables, as spans of text.
+        std::string text{};
+        std::vector<std::pair<std::size_t, std::size_t>> lines{};
+        std::vector<Step> steps{};
+        std::vector<Source> sources{};
+        // Read in all files, including comments and directives.
+        std::size_t lineCount = 0;
+    };
+
+    /**
+     * @brief This class expands the directives of a script into a list of steps.
+     *
+     * Lines starting with one of these words are directives, all others are
+     * commands as in plain scripts:
+     *
+     *     include <file>     inserts the lines of another script, relative to this one
+     *     set <name> <text>  sets a variable to the rest of the line
+     *     repeat <count>     runs the lines up to the matching "end" count times
+     *     end
+     *
+     * "$name" and "${name}" are replaced by the value of the variable in all
+     * lines, "$$" stands for a single '$'. Variables are replaced as the
+     * script is read, top to bottom, so a set within a repeat takes effect
+     * once, in the order of the text.
+     *
+     * Each file is read once however often it is included, and the body of a
+     * repeat is stored once however often it runs.
+     */
+    class ScriptPreprocessor {
+    public:
+        ScriptPreprocessor();
+
+        /**
+         * @brief This function preprocesses a script.
+         *
+         * @param filename The pathname of the script, "-" stands for stdin.
+         * @param script Where the result is stored.
+         * @param error Explains what is wrong, with file and line, if this fails.
+         *              It is left empty if the script itself cannot be read.
+         *
+         * @return Whether the script could be read and is valid.
+         */
+        bool preprocess(const std::string &filename, PreprocessedScript &script, std::string &error);
+
+    private:
+        ScriptPreprocessor(const ScriptPreprocessor &) = delete;
+
+        ScriptPreprocessor &operator=(const ScriptPreprocessor &) = delete;
+
+        struct File {
+            std::string text{};
+            std::vector<std::pair<std::size_t, std::size_t>> lines{};
+        };
+
+        // Returns nullptr if the file cannot be read, reading it only the first time.
+        const File *read(const std::string &filename, PreprocessedScript &script);
+
+        bool process(const std::string &filename, PreprocessedScript &script, std::string &error);
+
+        // Returns the name of a missing variable through missing if this fails.
+        bool substitute(std::string_view line, std::string &result, std::string &missing) const;
+
+        std::unordered_map<std::string, std::unique_ptr<File>> files_;
+        std::unordered_map<std::string, std::string> variables_;
+        // The files being processed, innermost last, to detect include cycles.
+        std::vector<std::string> including_;
+        // The steps of the repeats whose end has not been seen yet.
+        std::vector<std::size_t> repeats_;
+    };
+}
+
+#endif
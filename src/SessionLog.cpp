@@ -0,0 +1,157 @@
+#include "SessionLog.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace CppReadline {
+    namespace {
+
+        constexpr std::size_t threshold = 1 << 16;
+
+        std::uint64_t microseconds(std::chrono::nanoseconds duration) {
+            return duration.count() > 0 ? static_cast<std::uint64_t>(duration.count() / 1000) : 0;
+        }
+
+        // Small magnitudes of either sign stay small.
+        std::uint64_t zigzag(std::int64_t value) {
+            return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+        }
+
+        std::int64_t unzigzag(std::uint64_t value) {
+            return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+        }
+
+    }  /* namespace  */
+
+    SessionRecorder::SessionRecorder() : mutex_(), fd_(-1), start_(), previous_(0), buffer_() {}
+
+    SessionRecorder::~SessionRecorder() {
+        close();
+    }
+
+    bool SessionRecorder::open(const std::string &filename) {
+        close();
+        std::lock_guard<std::mutex> lock(mutex_);
+        fd_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd_ < 0) { return false; }
+        start_ = Clock::now();
+        previous_ = 0;
+        buffer_.assign(SessionLog::Magic, sizeof(SessionLog::Magic));
+        SessionLog::putVarint(buffer_, microseconds(std::chrono::system_clock::now().time_since_epoch()));
+        return true;
+    }
+
+    void SessionRecorder::close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ < 0) { return; }
+        writeOut();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool SessionRecorder::isOpen() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return fd_ >= 0;
+    }
+
+    void SessionRecorder::record(std::string_view command, int result, Clock::time_point start,
+                                 Clock::duration elapsed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ < 0) { return; }
+        auto time = microseconds(start - start_);
+        // Commands finishing on other threads may be recorded out of order.
+        SessionLog::putVarint(buffer_, zigzag(static_cast<std::int64_t>(time - previous_)));
+        previous_ = time;
+        SessionLog::putVarint(buffer_, microseconds(elapsed));
+        SessionLog::putVarint(buffer_, zigzag(result));
+        SessionLog::putVarint(buffer_, command.size());
+        buffer_.append(command.data(), command.size());
+        if (buffer_.size() >= threshold) { writeOut(); }
+    }
+
+    void SessionRecorder::flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ >= 0) { writeOut(); }
+    }
+
+    void SessionRecorder::writeOut() {
+        std::size_t written = 0;
+        while (written < buffer_.size()) {
+            auto count = ::write(fd_, buffer_.data() + written, buffer_.size() - written);
+            if (count < 0) {
+                if (errno == EINTR) { continue; }
+                break;
+            }
+            written += static_cast<std::size_t>(count);
+        }
+        buffer_.clear();
+    }
+
+    SessionLog::SessionLog() : text_(), entries_(), started_() {}
+
+    bool SessionLog::load(const std::string &filename) {
+        entries_.clear();
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) { return false; }
+        auto text = std::make_shared<std::string>(std::istreambuf_iterator<char>(file),
+                                                  std::istreambuf_iterator<char>());
+        std::string_view input(*text);
+        if (input.substr(0, sizeof(Magic)) != std::string_view(Magic, sizeof(Magic))) { return false; }
+        input.remove_prefix(sizeof(Magic));
+        std::uint64_t started;
+        if (!getVarint(input, started)) { return false; }
+        started_ = std::chrono::system_clock::time_point(std::chrono::microseconds(started));
+
+        std::uint64_t time = 0, delta, duration, result, size;
+        bool ordered = true;
+        while (getVarint(input, delta) && getVarint(input, duration) && getVarint(input, result) &&
+               getVarint(input, size) && size <= input.size()) {
+            auto previous = time;
+            time += static_cast<std::uint64_t>(unzigzag(delta));
+            ordered = ordered && time >= previous;
+            entries_.push_back(Entry{time, duration, static_cast<int>(unzigzag(result)), input.substr(0, size)});
+            input.remove_prefix(size);
+        }
+        if (!ordered) {
+            std::stable_sort(entries_.begin(), entries_.end(), [](const Entry &a, const Entry &b) {
+                return a.time < b.time;
+            });
+        }
+        text_ = std::move(text);
+        return true;
+    }
+
+    const std::vector<SessionLog::Entry> &SessionLog::entries() const {
+        return entries_;
+    }
+
+    std::chrono::system_clock::time_point SessionLog::started() const {
+        return started_;
+    }
+
+    void SessionLog::putVarint(std::string &buffer, std::uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    bool SessionLog::getVarint(std::string_view &input, std::uint64_t &value) {
+        value = 0;
+        for (std::size_t i = 0; i < input.size() && i < 10; ++i) {
+            auto byte = static_cast<unsigned char>(input[i]);
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << (7 * i);
+            if (!(byte & 0x80)) {
+                input.remove_prefix(i + 1);
+                return true;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef CONSOLE_SESSION_LOG_HEADER_FILE
+#define CONSOLE_SESSION_LOG_HEADER_FILE
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class records the commands of a console session into a compact binary log.
+     *
+     * Each command is stored with the time it started, relative to the
+     * start of the recording, how long it took and what it returned. Times
+     * are kept in microseconds and written as variable length integers, so
+     * a typical entry takes a few bytes plus the command line itself.
+     *
+     * Entries are buffered and written out in large blocks, on flush() and
+     * on destruction. The recorder can be written to from multiple threads.
+     */
+    class SessionRecorder {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        SessionRecorder();
+
+        ~SessionRecorder();
+
+        /**
+         * @brief This function starts a recording, replacing the file if it exists.
+         *
+         * @return Whether the file could be created.
+         */
+        bool open(const std::string &filename);
+
+        /**
+         * @brief This function writes out what is buffered and stops recording.
+         */
+        void close();
+
+        /**
+         * @brief This function returns whether a recording is in progress.
+         */
+        bool isOpen() const;
+
+        /**
+         * @brief This function records an executed command.
+         *
+         * @param command The command line as it was executed.
+         * @param result The code the command returned.
+         * @param start When the command started.
+         * @param elapsed How long the command took.
+         */
+        void record(std::string_view command, int result, Clock::time_point start, Clock::duration elapsed);
+
+        /**
+         * @brief This function writes out the buffered entries.
+         */
+        void flush();
+
+    private:
+        SessionRecorder(const SessionRecorder &) = delete;
+
+        SessionRecorder &operator=(const SessionRecorder &) = delete;
+
+        void writeOut();
+
+        mutable std::mutex mutex_;
+        int fd_;
+        Clock::time_point start_;
+        // The start of the previous entry in microseconds, entries store the difference.
+        std::uint64_t previous_;
+        std::string buffer_;
+    };
+
+    /**
+     * @brief This class holds a session log written by SessionRecorder.
+     */
+    class SessionLog {
+    public:
+        struct Entry {
+            std::uint64_t time;     // Microseconds since the start of the recording.
+            std::uint64_t duration; // Microseconds the command took.
+            int result;
+            std::string_view command;
+        };
+
+        SessionLog();
+
+        /**
+         * @brief This function reads a log, replacing the entries held.
+         *
+         * A log cut short, e.g. because the recording process was killed
+         * before its last flush, keeps the entries read completely.
+         *
+         * @return Whether the file could be read and is a session log.
+         */
+        bool load(const std::string &filename);
+
+        /**
+         * @brief This function returns the entries, ordered by time.
+         */
+        const std::vector<Entry> &entries() const;
+
+        /**
+         * @brief This function returns the wall clock time the recording started at.
+         */
+        std::chrono::system_clock::time_point started() const;
+
+    private:
+        friend class SessionRecorder;
+
+        static constexpr char Magic[] = {'C', 'R', 'S', 'L', 1};
+
+        static void putVarint(std::string &buffer, std::uint64_t value);
+
+        static bool getVarint(std::string_view &input, std::uint64_t &value);
+
+        // The entries view the command lines stored in here.
+        std::shared_ptr<const std::string> text_;
+        std::vector<Entry> entries_;
+        std::chrono::system_clock::time_point started_;
+    };
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "SessionReplayer.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace CppReadline {
+    namespace {
+
+        class DiscardSink : public OutputSink {
+        public:
+            void write(std::string_view) override {}
+        };
+
+    }  /* namespace  */
+
+    double ReplayStatistics::quantile(double q) const {
+        auto rank = q * commands;
+        for (auto &bucket : buckets) {
+            if (bucket.second >= rank) { return std::min(bucket.first, maxSeconds); }
+        }
+        return maxSeconds;
+    }
+
+    SessionReplayer::SessionReplayer(Console &console) : console_(console) {}
+
+    ReplayStatistics SessionReplayer::replay(const SessionLog &log, const ReplayOptions &options) {
+        using Clock = std::chrono::steady_clock;
+        LatencyHistogram latency;
+        std::atomic<std::uint64_t> mismatches(0);
+        DiscardSink discard;
+        auto &output = options.output ? *options.output : static_cast<OutputSink &>(discard);
+        auto &entries = log.entries();
+
+        auto start = Clock::now();
+        auto session = [&] {
+            std::uint64_t differing = 0;
+            for (auto &entry : entries) {
+                auto due = Clock::now();
+                if (options.speed > 0.0) {
+                    due = start + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double, std::micro>(entry.time / options.speed));
+                    std::this_thread::sleep_until(due);
+                }
+                int result = console_.executeCommand(entry.command, output);
+                latency.record(static_cast<std::uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - due).count()));
+                if (result != entry.result) { ++differing; }
+            }
+            mismatches += differing;
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < options.sessions; ++i) { threads.emplace_back(session); }
+        // The calling thread replays a session as well.
+        if (options.sessions) { session(); }
+        for (auto &thread : threads) { thread.join(); }
+
+        ReplayStatistics statistics;
+        statistics.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        statistics.mismatches = mismatches;
+        statistics.maxSeconds = latency.max() * 1e-9;
+        LatencyHistogram::Buckets buckets;
+        latency.snapshot(buckets);
+        statistics.buckets.reserve(buckets.size());
+        for (auto &bucket : buckets) {
+            statistics.commands += bucket.second;
+            statistics.buckets.emplace_back(bucket.first * 1e-9, statistics.commands);
+        }
+        return statistics;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef CONSOLE_SESSION_REPLAYER_HEADER_FILE
+#define CONSOLE_SESSION_REPLAYER_HEADER_FILE
+
+#include "Console.hpp"
+#include "SessionLog.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This struct holds the settings of a replay.
+     */
+    struct ReplayOptions {
+        // How much faster than recorded the commands are sent, 0 sends them
+        // as fast as possible.
+        double speed = 1.0;
+        // The number of copies of the session replayed at the same time,
+        // each on its own thread.
+        std::size_t sessions = 1;
+        // Where the output of the commands goes, it is discarded by default.
+        // It is written to by all sessions at once.
+        OutputSink *output = nullptr;
+    };
+
+    /**
+     * @brief This struct reports how a replay went.
+     *
+     * The latency of a command is measured from the time it was due, not
+     * from when it actually started, so that a command held up by slow
+     * predecessors counts the wait as well. As fast as possible, both are
+     * the same. The buckets are laid out like those of Console::CommandStatistics.
+     */
+    struct ReplayStatistics {
+        std::uint64_t commands = 0;   // Commands executed, by all sessions.
+        std::uint64_t mismatches = 0; // Commands which returned something else than recorded.
+        double seconds = 0.0;         // Wall clock time of the whole replay.
+        double maxSeconds = 0.0;      // Highest latency.
+        std::vector<std::pair<double, std::uint64_t>> buckets;
+
+        ReplayStatistics() : buckets() {}
+
+        double commandsPerSecond() const { return seconds > 0.0 ? commands / seconds : 0.0; }
+
+        /**
+         * @brief This function returns the upper bound of the bucket holding the given quantile.
+         *
+         * @param q The quantile, between 0 and 1.
+         */
+        double quantile(double q) const;
+    };
+
+    /**
+     * @brief This class replays recorded sessions against a Console, to load test its commands.
+     *
+     * The commands are executed with executeCommand, keeping the gaps
+     * between them as recorded, divided by the speed. A session which falls
+     * behind catches up by executing the overdue commands back to back.
+     */
+    class SessionReplayer {
+    public:
+        /**
+         * @brief Basic constructor.
+         *
+         * @param console The Console executing the commands, it must outlive the replayer.
+         */
+        explicit SessionReplayer(Console &console);
+
+        /**
+         * @brief This function replays a session and waits until all copies are done.
+         *
+         * A command returning Quit does not end the replay.
+         */
+        ReplayStatistics replay(const SessionLog &log, const ReplayOptions &options = ReplayOptions());
+
+    private:
+        Console &console_;
+    };
+}
+
+#endif
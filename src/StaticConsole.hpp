@@ -0,0 +1,202 @@
+#ifndef CONSOLE_STATIC_CONSOLE_HEADER_FILE
+#define CONSOLE_STATIC_CONSOLE_HEADER_FILE
+
+#include "Tokenizer.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace CppReadline {
+    /**
+     * @brief This class dispatches a set of commands known at compile time, without the library.
+     *
+     * Each command is a type with a static name and a call operator taking
+     * the tokens of the line, the first being the name itself, like the
+     * handlers of Console::CommandViewFunction:
+     *
+     *     struct Ping {
+     *         static constexpr std::string_view name = "ping";
+     *         int operator()(const std::vector<std::string_view> &arguments) { ... }
+     *     };
+     *
+     *     CppReadline::StaticConsole<Ping, Reset> console;
+     *     console.execute("ping 10.0.0.1");
+     *
+     * The names are hashed into a collision free table while compiling, so
+     * finding a command takes one hash of its name, one table lookup and
+     * one comparison. The handlers are called directly, with neither
+     * std::function nor virtual calls in between, so the compiler can
+     * inline them. The class is header only; it neither reads input nor
+     * completes, which a Console can do in front of it, see setFallback.
+     *
+     * Like a Console, the commands return 0 for Ok, -1 for Quit and
+     * greater values for errors. A name which is not a command returns 1.
+     * A StaticConsole must only be used by one thread at a time.
+     */
+    template <typename... Commands>
+    class StaticConsole {
+        static_assert(sizeof...(Commands) > 0, "A StaticConsole needs at least one command");
+        static_assert(sizeof...(Commands) < 0xffff, "A StaticConsole holds at most 65534 commands");
+
+    public:
+        using ArgumentViews = Tokenizer::Tokens;
+        // Executes the lines naming none of the commands.
+        using Fallback = std::function<int(std::string_view line)>;
+
+        static constexpr std::size_t npos = sizeof...(Commands);
+
+        StaticConsole() : commands_(), tokenizer_(), fallback_() {}
+
+        explicit StaticConsole(Commands... commands)
+                : commands_(std::move(commands)...), tokenizer_(), fallback_() {}
+
+        /**
+         * @brief This function executes a command line.
+         *
+         * @return What the command returned, Ok for an empty line.
+         */
+        int execute(std::string_view line) {
+            auto &tokens = tokenizer_.tokenize(line);
+            if (tokens.empty()) { return 0; }
+            auto index = find(tokens[0]);
+            if (index == npos) { return fallback_ ? fallback_(line) : 1; }
+            return call(index, tokens, std::index_sequence_for<Commands...>());
+        }
+
+        /**
+         * @brief This function executes an already tokenized command line.
+         *
+         * The fallback is not used, since it takes the whole line.
+         */
+        int execute(const ArgumentViews &tokens) {
+            if (tokens.empty()) { return 0; }
+            auto index = find(tokens[0]);
+            if (index == npos) { return 1; }
+            return call(index, tokens, std::index_sequence_for<Commands...>());
+        }
+
+        /**
+         * @brief Sets what executes the lines naming none of the commands.
+         *
+         * E.g. [&console](std::string_view line) { return console.executeCommand(line); }
+         * hands them on to a Console with the commands registered at runtime.
+         */
+        void setFallback(Fallback fallback) {
+            fallback_ = std::move(fallback);
+        }
+
+        /**
+         * @brief This function returns the position of a command in Commands, or npos.
+         */
+        static constexpr std::size_t find(std::string_view name) {
+            auto slot = table_.slots[hash(name, table_.seed) & table_.mask];
+            if (slot == 0 || names_[slot - 1u] != name) { return npos; }
+            return slot - 1u;
+        }
+
+        /**
+         * @brief This function returns the names of the commands, in the order of Commands.
+         */
+        static constexpr const std::array<std::string_view, sizeof...(Commands)> &names() {
+            return names_;
+        }
+
+        /**
+         * @brief This function returns a command, e.g. to reach its state.
+         */
+        template <typename Command>
+        Command &get() {
+            return std::get<Command>(commands_);
+        }
+
+    private:
+        // The smallest power of two holding all names at most half full.
+        static constexpr std::size_t MinimumSize = [] {
+            std::size_t size = 1;
+            while (size < 2 * sizeof...(Commands)) { size <<= 1; }
+            return size;
+        }();
+        // Larger tables are only tried if no seed separates the names in a smaller one.
+        static constexpr std::size_t MaximumSize = MinimumSize * 8;
+        static constexpr std::uint64_t Seeds = 1 << 12;
+
+        struct Layout {
+            std::uint64_t seed;
+            std::size_t mask;
+            bool found;
+        };
+
+        struct Table {
+            std::uint64_t seed;
+            std::size_t mask;
+            // Position in Commands plus one, 0 for empty slots.
+            std::array<std::uint16_t, MaximumSize> slots;
+        };
+
+        // FNV-1a, with the seed mixed into the offset basis.
+        static constexpr std::uint64_t hash(std::string_view text, std::uint64_t seed) {
+            std::uint64_t value = 14695981039346656037ull ^ (seed * 0x9e3779b97f4a7c15ull);
+            for (char c : text) {
+                value ^= static_cast<unsigned char>(c);
+                value *= 1099511628211ull;
+            }
+            return value;
+        }
+
+        static constexpr bool separates(std::uint64_t seed, std::size_t mask) {
+            std::array<bool, MaximumSize> used{};
+            for (auto name : names_) {
+                auto slot = hash(name, seed) & mask;
+                if (used[slot]) { return false; }
+                used[slot] = true;
+            }
+            return true;
+        }
+
+        static constexpr Layout layout() {
+            for (std::size_t size = MinimumSize; size <= MaximumSize; size <<= 1) {
+                for (std::uint64_t seed = 0; seed < Seeds; ++seed) {
+                    if (separates(seed, size - 1)) { return Layout{seed, size - 1, true}; }
+                }
+            }
+            return Layout{0, 0, false};
+        }
+
+        static constexpr Table build() {
+            constexpr Layout found = layout();
+            static_assert(found.found, "The command names of a StaticConsole must be unique");
+            Table table{found.seed, found.mask, {}};
+            for (std::size_t i = 0; i < names_.size(); ++i) {
+                table.slots[hash(names_[i], found.seed) & found.mask] = static_cast<std::uint16_t>(i + 1);
+            }
+            return table;
+        }
+
+        // Expands into a switch over the positions, calling each handler directly.
+        template <std::size_t... I>
+        int call(std::size_t index, const ArgumentViews &tokens, std::index_sequence<I...>) {
+            int result = 1;
+            static_cast<void>(((index == I && (result = std::get<I>(commands_)(tokens), true)) || ...));
+            return result;
+        }
+
+        static constexpr std::array<std::string_view, sizeof...(Commands)> names_{{Commands::name...}};
+        // Defined below, since the class must be complete to build it.
+        static const Table table_;
+
+        std::tuple<Commands...> commands_;
+        Tokenizer tokenizer_;
+        Fallback fallback_;
+    };
+
+    template <typename... Commands>
+    constexpr typename StaticConsole<Commands...>::Table StaticConsole<Commands...>::table_ =
+            StaticConsole<Commands...>::build();
+}
+
+#endif
@@ -0,0 +1,45 @@
+#include "ThreadPool.hpp"
+
+namespace CppReadline {
+    ThreadPool::ThreadPool(std::size_t threads) : mutex_(), ready_(), tasks_(), stopping_(false), workers_() {
+        if (threads == 0) { threads = 1; }
+        workers_.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) { workers_.emplace_back(&ThreadPool::work, this); }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (auto &worker : workers_) { worker.join(); }
+    }
+
+    void ThreadPool::submit(Task task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        ready_.notify_one();
+    }
+
+    std::size_t ThreadPool::size() const {
+        return workers_.size();
+    }
+
+    void ThreadPool::work() {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                // Queued tasks still run when stopping.
+                if (tasks_.empty()) { return; }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CONSOLE_THREAD_POOL_HEADER_FILE
+#define CONSOLE_THREAD_POOL_HEADER_FILE
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class runs tasks on a fixed set of worker threads.
+     *
+     * Tasks are run in submission order. Destroying the pool runs the tasks
+     * still queued and waits for all of them to return.
+     */
+    class ThreadPool {
+    public:
+        using Task = std::function<void()>;
+
+        /**
+         * @brief Basic constructor.
+         *
+         * @param threads The number of worker threads, at least one is started.
+         */
+        explicit ThreadPool(std::size_t threads);
+
+        ~ThreadPool();
+
+        /**
+         * @brief This function queues a task for execution.
+         */
+        void submit(Task task);
+
+        /**
+         * @brief This function returns the number of worker threads.
+         */
+        std::size_t size() const;
+
+    private:
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void work();
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<Task> tasks_;
+        bool stopping_;
+        std::vector<std::thread> workers_;
+    };
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef CONSOLE_TOKENIZER_HEADER_FILE
+#define CONSOLE_TOKENIZER_HEADER_FILE
+
+#include <string_view>
+#include <vector>
+
+namespace CppReadline {
+    /**
+     * @brief This class splits a command line into whitespace separated tokens.
+     *
+     * The tokens are views into the tokenized line, so they are only valid for
+     * as long as the line itself is. The token buffer is reused between calls,
+     * so once it has grown to fit the longest line no more allocations happen.
+     */
+    class Tokenizer {
+    public:
+        using Tokens = std::vector<std::string_view>;
+
+        Tokenizer() : tokens_() {}
+
+        /**
+         * @brief This function returns whether the character separates tokens.
+         *
+         * It matches what std::isspace reports for the "C" locale, so lines are
+         * split exactly as an std::istream would split them.
+         */
+        static constexpr bool isSeparator(char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+        }
+
+        /**
+         * @brief This function splits a line, replacing the previous tokens.
+         *
+         * @param line The line to split.
+         *
+         * @return The tokens found in the line.
+         */
+        const Tokens &tokenize(std::string_view line) {
+            tokens_.clear();
+            const char *it = line.data(), *end = line.data() + line.size();
+            while (true) {
+                while (it != end && isSeparator(*it)) { ++it; }
+                if (it == end) { break; }
+                const char *start = it;
+                while (it != end && !isSeparator(*it)) { ++it; }
+                tokens_.emplace_back(start, static_cast<std::size_t>(it - start));
+            }
+            return tokens_;
+        }
+
+        /**
+         * @brief This function returns the tokens found by the last tokenize() call.
+         */
+        const Tokens &tokens() const { return tokens_; }
+
+    private:
+        Tokens tokens_;
+    };
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include "TraceSink.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace CppReadline {
+    namespace {
+
+        std::atomic<std::uint32_t> nextThread(1);
+        thread_local std::uint32_t currentThread = 0;
+
+        constexpr std::size_t detailSize = 32;
+
+    }  /* namespace  */
+
+    TraceSink::~TraceSink() {}
+
+    void TraceSink::flush() {}
+
+    std::uint32_t TraceSink::thread() {
+        if (!currentThread) { currentThread = nextThread.fetch_add(1, std::memory_order_relaxed); }
+        return currentThread;
+    }
+
+    TraceRing::TraceRing(std::size_t capacity) : slots_(), mask_(0), head_(0) {
+        std::size_t size = 1;
+        while (size < capacity) { size <<= 1; }
+        slots_.reset(new Slot[size]);
+        mask_ = size - 1;
+        for (std::size_t i = 0; i < size; ++i) { slots_[i].sequence.store(0, std::memory_order_relaxed); }
+    }
+
+    TraceRing::~TraceRing() {}
+
+    void TraceRing::record(const TraceEvent &event) {
+        auto index = head_.fetch_add(1, std::memory_order_relaxed);
+        auto &slot = slots_[index & mask_];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.start.store(event.start, std::memory_order_relaxed);
+        slot.duration.store(event.duration, std::memory_order_relaxed);
+        slot.thread.store(event.thread, std::memory_order_relaxed);
+        auto size = std::min(event.detail.size(), detailSize);
+        slot.size.store(static_cast<std::uint32_t>(size), std::memory_order_relaxed);
+        for (std::size_t i = 0; i * 8 < size; ++i) {
+            std::uint64_t word = 0;
+            std::memcpy(&word, event.detail.data() + i * 8, std::min<std::size_t>(8, size - i * 8));
+            slot.detail[i].store(word, std::memory_order_relaxed);
+        }
+
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+    }
+
+    void TraceRing::dump(TraceSink &sink) const {
+        auto head = head_.load(std::memory_order_acquire);
+        auto capacity = static_cast<std::uint64_t>(mask_) + 1;
+        char detail[detailSize];
+        for (auto index = head > capacity ? head - capacity : 0; index < head; ++index) {
+            auto &slot = slots_[index & mask_];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            // Still being written, or overwritten by a later event.
+            if (sequence != 2 * index + 2) { continue; }
+
+            TraceEvent event{slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                             slot.duration.load(std::memory_order_relaxed),
+                             slot.thread.load(std::memory_order_relaxed), std::string_view()};
+            auto size = std::min<std::size_t>(slot.size.load(std::memory_order_relaxed), detailSize);
+            for (std::size_t i = 0; i * 8 < size; ++i) {
+                auto word = slot.detail[i].load(std::memory_order_relaxed);
+                std::memcpy(detail + i * 8, &word, std::min<std::size_t>(8, size - i * 8));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) { continue; }
+
+            event.detail = std::string_view(detail, size);
+            sink.record(event);
+        }
+    }
+
+    std::uint64_t TraceRing::recorded() const {
+        return head_.load(std::memory_order_relaxed);
+    }
+
+    std::size_t TraceRing::capacity() const {
+        return mask_ + 1;
+    }
+
+    ChromeTraceSink::ChromeTraceSink() : mutex_(), file_(), output_(), writer_(), pid_(getpid()) {}
+
+    ChromeTraceSink::~ChromeTraceSink() {
+        close();
+    }
+
+    bool ChromeTraceSink::open(const std::string &filename) {
+        close();
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.open(filename, std::ios::binary | std::ios::trunc);
+        if (!file_) { return false; }
+        output_.reset(new BufferedSink(file_));
+        writer_.setSink(output_.get());
+        // Naming the process first lets every event start with a comma.
+        *output_ << "[\n";
+        writer_.begin().field("name", "process_name").field("ph", "M").field("pid", pid_)
+               .key("args").beginObject().field("name", "cpp-readline").endObject().end();
+        return true;
+    }
+
+    void ChromeTraceSink::close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!output_) { return; }
+        *output_ << "]\n";
+        writer_.setSink(nullptr);
+        output_.reset();
+        file_.close();
+    }
+
+    void ChromeTraceSink::record(const TraceEvent &event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!output_) { return; }
+        *output_ << ',';
+        writer_.begin().field("name", event.name).field("ph", "X").field("ts", event.start * 1e-3)
+               .field("dur", event.duration * 1e-3).field("pid", pid_).field("tid", event.thread);
+        if (!event.detail.empty()) { writer_.key("args").beginObject().field("detail", event.detail).endObject(); }
+        writer_.end();
+    }
+
+    void ChromeTraceSink::flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (output_) { output_->flush(); }
+    }
+}
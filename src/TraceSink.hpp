@@ -0,0 +1,203 @@
+#ifndef CONSOLE_TRACE_SINK_HEADER_FILE
+#define CONSOLE_TRACE_SINK_HEADER_FILE
+
+#include "OutputSink.hpp"
+#include "RecordWriter.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Building with -DCPP_READLINE_TRACING=0 compiles all tracing hooks out.
+#ifndef CPP_READLINE_TRACING
+#define CPP_READLINE_TRACING 1
+#endif
+
+namespace CppReadline {
+    /**
+     * @brief This struct describes a traced span of time on a thread.
+     */
+    struct TraceEvent {
+        const char *name;        // What happened, a string literal like "tokenize".
+        std::uint64_t start;     // Nanoseconds, on the steady clock.
+        std::uint64_t duration;  // Nanoseconds.
+        std::uint32_t thread;    // A small number identifying the thread.
+        std::string_view detail; // E.g. the command, only valid during the call.
+    };
+
+    /**
+     * @brief This is the interface traced events are handed to.
+     *
+     * Events are recorded from every thread executing commands, at the end
+     * of each span, so implementations must be thread-safe.
+     */
+    class TraceSink {
+    public:
+        virtual ~TraceSink();
+
+        /**
+         * @brief This function takes an event.
+         */
+        virtual void record(const TraceEvent &event) = 0;
+
+        /**
+         * @brief This function pushes buffered events, if any, to their final destination.
+         */
+        virtual void flush();
+
+        /**
+         * @brief This function returns the current time as used by the events.
+         */
+        static std::uint64_t now() {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        /**
+         * @brief This function returns the number identifying the calling thread.
+         */
+        static std::uint32_t thread();
+    };
+
+    /**
+     * @brief This class traces the span of time it exists for.
+     *
+     * Without a sink it does nothing but a null check, and with tracing
+     * compiled out not even that.
+     */
+    class TraceScope {
+    public:
+        TraceScope(TraceSink *sink, const char *name, std::string_view detail = std::string_view())
+                : sink_(CPP_READLINE_TRACING ? sink : nullptr), name_(name), detail_(detail),
+                  start_(sink_ ? TraceSink::now() : 0) {}
+
+        ~TraceScope() { end(); }
+
+        /**
+         * @brief This function ends the span before the scope does.
+         */
+        void end() {
+            if (!sink_) { return; }
+            sink_->record(TraceEvent{name_, start_, TraceSink::now() - start_, TraceSink::thread(), detail_});
+            sink_ = nullptr;
+        }
+
+    private:
+        TraceScope(const TraceScope &) = delete;
+
+        TraceScope &operator=(const TraceScope &) = delete;
+
+        TraceSink *sink_;
+        const char *name_;
+        std::string_view detail_;
+        std::uint64_t start_;
+    };
+
+    /**
+     * @brief This sink keeps the latest events in a fixed size ring, to be dumped on demand.
+     *
+     * Recording is lock-free: a thread claims a slot with a single atomic
+     * increment and publishes the event through the sequence number of the
+     * slot, so recording threads never wait for each other or for a dump.
+     * Events being overwritten while dumped are skipped. Details are cut
+     * to 32 bytes.
+     */
+    class TraceRing : public TraceSink {
+    public:
+        /**
+         * @brief Basic constructor.
+         *
+         * @param capacity The number of events kept, rounded up to a power of two.
+         */
+        explicit TraceRing(std::size_t capacity = 1 << 14);
+
+        ~TraceRing() override;
+
+        void record(const TraceEvent &event) override;
+
+        /**
+         * @brief This function hands the events kept to another sink, oldest first.
+         */
+        void dump(TraceSink &sink) const;
+
+        /**
+         * @brief This function returns the number of events recorded in total, including overwritten ones.
+         */
+        std::uint64_t recorded() const;
+
+        /**
+         * @brief This function returns the number of events kept.
+         */
+        std::size_t capacity() const;
+
+    private:
+        TraceRing(const TraceRing &) = delete;
+
+        TraceRing &operator=(const TraceRing &) = delete;
+
+        // All fields are atomic, so that dumping while recording is well defined.
+        struct Slot {
+            // Odd while being written, 2 * (index + 1) once event index is complete.
+            std::atomic<std::uint64_t> sequence;
+            std::atomic<const char *> name;
+            std::atomic<std::uint64_t> start;
+            std::atomic<std::uint64_t> duration;
+            std::atomic<std::uint32_t> thread;
+            std::atomic<std::uint32_t> size;
+            std::array<std::atomic<std::uint64_t>, 4> detail;
+        };
+
+        std::unique_ptr<Slot[]> slots_;
+        std::size_t mask_;
+        std::atomic<std::uint64_t> head_;
+    };
+
+    /**
+     * @brief This sink writes events to a file in the Chrome trace event format.
+     *
+     * The file can be loaded into chrome://tracing or Perfetto. Each event
+     * becomes a complete ("X") event, with the detail as its argument.
+     * Events are buffered, and written out in large blocks.
+     */
+    class ChromeTraceSink : public TraceSink {
+    public:
+        ChromeTraceSink();
+
+        ~ChromeTraceSink() override;
+
+        /**
+         * @brief This function starts a trace, replacing the file if it exists.
+         *
+         * @return Whether the file could be created.
+         */
+        bool open(const std::string &filename);
+
+        /**
+         * @brief This function completes the trace and closes the file.
+         */
+        void close();
+
+        void record(const TraceEvent &event) override;
+
+        void flush() override;
+
+    private:
+        ChromeTraceSink(const ChromeTraceSink &) = delete;
+
+        ChromeTraceSink &operator=(const ChromeTraceSink &) = delete;
+
+        std::mutex mutex_;
+        std::ofstream file_;
+        std::unique_ptr<BufferedSink> output_;
+        RecordWriter writer_;
+        int pid_;
+    };
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "../src/Console.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
+
+namespace cr = CppReadline;
+
+namespace {
+
+    class NullSink : public cr::OutputSink {
+    public:
+        void write(std::string_view) override {}
+    };
+
+    int failures = 0;
+
+    void check(bool condition, const char *what) {
+        if (condition) { return; }
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+
+    void writeScript(const char *filename, const char *second) {
+        std::ofstream script(filename);
+        script << "slow\n" << second << '\n';
+        for (int i = 0; i < 200; ++i) { script << "fast\n"; }
+    }
+
+}  /* namespace  */
+
+// A failing or throwing line of a parallel script stops the lines after it from being started.
+int main() {
+    char filename[] = "/tmp/cpp-readline-test-XXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0) { return 1; }
+    close(fd);
+
+    cr::Console c(">");
+    c.setOutputSink(std::make_shared<NullSink>());
+    c.setQuiet(true);
+    std::atomic<int> fast(0);
+    c.registerCommand("slow", {[](const cr::Console::ArgumentViews &) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return 0;
+    }, {}});
+    c.registerCommand("fail", {[](const cr::Console::ArgumentViews &) { return 3; }, {}});
+    c.registerCommand("throw", {[](const cr::Console::ArgumentViews &) -> int {
+        throw std::runtime_error("thrown");
+    }, {}});
+    c.registerCommand("fast", {[&fast](const cr::Console::ArgumentViews &) {
+        ++fast;
+        return 0;
+    }, {}});
+
+    writeScript(filename, "fail");
+    for (bool cached : {false, true}) {
+        c.setScriptCaching(cached);
+        fast = 0;
+        int result = c.executeFile(filename, cr::ScriptOptions{2});
+        check(result == 3, cached ? "cached: the failing result is returned" : "the failing result is returned");
+        // The worker busy with "slow" may have claimed one more line at most.
+        check(fast <= 1, cached ? "cached: no lines start after the failure" : "no lines start after the failure");
+        check(c.getLastScriptStatistics().commands == 2, "only the lines up to the failure are reported");
+    }
+
+    // Thrown on a worker, the exception reaches the caller, as when run serially.
+    writeScript(filename, "throw");
+    for (bool cached : {false, true}) {
+        c.setScriptCaching(cached);
+        fast = 0;
+        bool thrown = false;
+        try {
+            c.executeFile(filename, cr::ScriptOptions{2});
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check(thrown, cached ? "cached: the exception is rethrown" : "the exception is rethrown");
+        check(fast <= 1, cached ? "cached: no lines start after the exception" : "no lines start after the exception");
+    }
+
+    unlink(filename);
+    return failures ? 1 : 0;
+}